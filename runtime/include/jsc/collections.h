@@ -0,0 +1,152 @@
+// Copyright (c) 2015 Tzvetan Mikov and contributors (see AUTHORS).
+// Licensed under the Apache License v2.0. See LICENSE in the project
+// root for complete license information.
+
+#ifndef JSCOMP_COLLECTIONS_H
+#define JSCOMP_COLLECTIONS_H
+
+#ifndef JSCOMP_OBJECTS_H
+#include "jsc/objects.h"
+#endif
+
+namespace js {
+
+class CollectionIterator;
+
+/**
+ * An insertion-ordered hash table keyed by SameValueZero, used by Map and Set.
+ *
+ * <p>The entries are kept in a vector in insertion order. Deleted entries are left in place with a
+ * VT_ARRAY_HOLE key, so deletion doesn't disturb the order. The index is an open-addressing (linear
+ * probing) table of entry numbers. The holes are squeezed out when the index is rebuilt.
+ */
+class OrderedHashTable
+{
+public:
+    struct Entry
+    {
+        TaggedValue key;
+        TaggedValue value;
+    };
+
+    std::vector<Entry> entries;
+    /** Number of entries which are not holes */
+    uint32_t count;
+
+    OrderedHashTable () :
+        count(0),
+        mask(0)
+    {}
+
+    TaggedValue * find (TaggedValue key);
+    /** Add or update an entry */
+    void set (TaggedValue key, TaggedValue value, std::vector<CollectionIterator *> & iterators);
+    bool erase (TaggedValue key);
+    void clear (std::vector<CollectionIterator *> & iterators);
+
+    bool mark (IMark * marker, unsigned markBit) const;
+
+private:
+    enum : uint32_t { EMPTY = UINT32_MAX, DELETED = UINT32_MAX - 1, MIN_CAPACITY = 8 };
+
+    /** Entry numbers, or EMPTY or DELETED */
+    std::vector<uint32_t> index;
+    uint32_t mask;
+
+    uint32_t * findSlot (TaggedValue key, uint32_t hash);
+    void rebuild (std::vector<CollectionIterator *> & iterators);
+};
+
+/**
+ * The common base of Map and Set.
+ */
+class Collection : public Object
+{
+    typedef Object super;
+public:
+    OrderedHashTable table;
+    /** The live iterators, which must be adjusted when the entries are compacted */
+    std::vector<CollectionIterator *> iterators;
+
+    Collection (Object * parent) :
+        Object(parent)
+    {}
+
+    virtual ~Collection ();
+    virtual bool mark (IMark * marker, unsigned markBit) const;
+
+    void set (TaggedValue key, TaggedValue value)
+    {
+        this->table.set(key, value, this->iterators);
+    }
+    void clear ()
+    {
+        this->table.clear(this->iterators);
+    }
+};
+
+class Map : public Collection
+{
+public:
+    Map (Object * parent) :
+        Collection(parent)
+    {
+        this->icls = ICLS_Map;
+    }
+
+    static TaggedValue aConstructor (StackFrame * caller, Env * env, unsigned argc, const TaggedValue * argv);
+    static TaggedValue aFunction (StackFrame * caller, Env * env, unsigned argc, const TaggedValue * argv);
+};
+
+class Set : public Collection
+{
+public:
+    Set (Object * parent) :
+        Collection(parent)
+    {
+        this->icls = ICLS_Set;
+    }
+
+    static TaggedValue aConstructor (StackFrame * caller, Env * env, unsigned argc, const TaggedValue * argv);
+    static TaggedValue aFunction (StackFrame * caller, Env * env, unsigned argc, const TaggedValue * argv);
+};
+
+/**
+ * Iterates the entries of a Map or Set in insertion order, seeing the entries added after it was created.
+ * It registers itself with the collection while it is not exhausted.
+ */
+class CollectionIterator : public Object
+{
+    typedef Object super;
+public:
+    enum Kind { KEYS, VALUES, ENTRIES };
+
+    /** NULL once the iterator is exhausted */
+    Collection * coll;
+    /** The next entry to examine */
+    uint32_t pos;
+    Kind kind;
+
+    CollectionIterator (Object * parent) :
+        Object(parent),
+        coll(NULL),
+        pos(0),
+        kind(KEYS)
+    {
+        this->icls = ICLS_CollectionIterator;
+    }
+
+    virtual ~CollectionIterator ();
+    virtual bool mark (IMark * marker, unsigned markBit) const;
+
+    void attach (Collection * coll, Kind kind);
+    void detach ();
+    /** Return the next entry or NULL */
+    const OrderedHashTable::Entry * next ();
+};
+
+void collectionsInit (StackFrame * caller);
+
+}; // namespace js
+
+#endif //JSCOMP_COLLECTIONS_H
@@ -17,7 +17,9 @@ namespace js {
 /**
  * Return true if "value" is representable as uint32_t, and store the uint32_t value in "res"
  */
-#define IS_FAST_UINT32(value,res)  ((value).tag == VT_NUMBER && ((res) = (uint32_t)(value).raw.nval) == (value).raw.nval)
+#define IS_FAST_UINT32(value,res)  ((value).isInt32() ? \
+    (int32_t)((res) = (uint32_t)(int32_t)(value).raw.ival) >= 0 : \
+    ((value).tag == VT_NUMBER && ((res) = (uint32_t)(value).raw.nval) == (value).raw.nval))
 #define IS_FAST_INT32(value,res)   ((value).tag == VT_NUMBER && ((res) = (int32_t)(value).raw.nval) == (value).raw.nval)
 
 class StringBuilder
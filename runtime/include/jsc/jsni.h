@@ -8,15 +8,20 @@
 #ifndef JSCOMP_RUNTIME_H
 #include "jsc/jsruntime.h"
 #endif
+#include <type_traits>
 
 namespace js {
 
+/**
+ * T must declare its own CLASS_BITS (NativeObject, IndexedObject, ArrayBase, Function). A class which only
+ * inherits them can't be told apart from its siblings by the class bits.
+ */
 template <class T>
 T * safeObjectCast(StackFrame * caller, const TaggedValue & tv, const char * err = NULL)
 {
-    T * res;
-    if (js::isValueTagObject(tv.tag) && (res = dynamic_cast<T *>(tv.raw.oval)) != NULL) {
-        return res;
+    static_assert(std::is_same<typename T::ClassBitsOwner, T>::value, "T doesn't declare its own CLASS_BITS");
+    if (js::isValueTagObject(tv.tag) && tv.raw.oval->hasClassBits(T::CLASS_BITS)) {
+        return static_cast<T *>(tv.raw.oval);
     } else {
         throwTypeError(caller, err ? err : "invalid object type");
         return NULL;
@@ -11,6 +11,9 @@
 #ifndef JSCOMP_TYPEDARRAYS_H
 #include "jsc/typedarrays.h"
 #endif
+#ifndef JSCOMP_COLLECTIONS_H
+#include "jsc/collections.h"
+#endif
 
 namespace js {
 
@@ -20,8 +23,8 @@ double mathRandom ();
 // string
 const StringPrim * toLowerCase (StackFrame * caller, const StringPrim * str);
 const StringPrim * toUpperCase (StackFrame * caller, const StringPrim * str);
-const void * _memmem (const void * big, size_t biglen, void * little, size_t littlelen);
-const void * memrmem (const void * big, size_t biglen, void * little, size_t littlelen);
+const void * _memmem (const void * big, size_t biglen, const void * little, size_t littlelen);
+const void * memrmem (const void * big, size_t biglen, const void * little, size_t littlelen);
 
 #ifdef HAVE_GOOD_MEMMEM
 #define jsmemmem ::memmem
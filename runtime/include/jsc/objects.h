@@ -17,6 +17,7 @@
 #include <math.h>
 #include <setjmp.h>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <new>
@@ -38,6 +39,7 @@ struct StringPrim;
 struct String;
 struct Array;
 class ForInIterator;
+struct EnumCache;
 struct StackFrame;
 struct Runtime;
 
@@ -70,16 +72,9 @@ enum InternalClass
     ICLS_Uint32Array  = 24,
     ICLS_Float32Array = 25,
     ICLS_Float64Array = 26,
-};
-
-union RawValue
-{
-    double nval;
-    bool   bval;
-    Object * oval;
-    Function * fval;
-    StringPrim * sval;
-    Memory * mval;
+    ICLS_Map          = 27,
+    ICLS_Set          = 28,
+    ICLS_CollectionIterator = 29,
 };
 
 enum ValueTag
@@ -88,6 +83,183 @@ enum ValueTag
     _VT_SHIFT = 3,
 };
 
+/**
+ * Values are NaN-boxed in 64 bits. A number is stored as its IEEE bits plus NUMBER_OFFSET, so numbers occupy
+ * everything from NUMBER_OFFSET up. All other values have the tag in the top 16 bits and the payload (a
+ * boolean or a pointer) in the low 48 bits, so all-zero bits are 'undefined'.
+ *
+ * <p>Only negative quiet NaN-s would wrap around when adding the offset, so NaN-s are canonicalized when
+ * they are stored.
+ *
+ * <p>Numbers which are int32 (except -0) are always stored as an int32 payload under the VT_NUMBER tag
+ * instead, so integer code doesn't need to convert to and from double. The representation of every number is
+ * canonical, so equal numbers have equal bits, except for +0 and -0.
+ *
+ * <p>The fields below give TaggedValue the interface of a tag and a union of payloads: 'v.tag', 'v.raw.nval',
+ * 'v.raw.oval->...' and so on, which is what the runtime and the generated code use.
+ */
+namespace box
+{
+enum : uint64_t
+{
+    NUMBER_OFFSET = (uint64_t)1 << 51,
+    PAYLOAD_BITS = 48,
+    PAYLOAD_MASK = ((uint64_t)1 << PAYLOAD_BITS) - 1,
+    CANONICAL_NAN = 0x7FF8000000000000ULL,
+    INT32_BASE = (uint64_t)VT_NUMBER << PAYLOAD_BITS,
+};
+
+inline bool isInt32 (uint64_t bits)
+{
+    return (bits >> PAYLOAD_BITS) == VT_NUMBER;
+}
+
+inline uint64_t encodeInt32 (int32_t i)
+{
+    return INT32_BASE | (uint32_t)i;
+}
+
+inline int32_t decodeInt32 (uint64_t bits)
+{
+    return (int32_t)(uint32_t)bits;
+}
+
+inline uint64_t encodeNumber (double d)
+{
+    if (d >= INT32_MIN && d <= INT32_MAX) {
+        int32_t i = (int32_t)d;
+        if (i == d && (i != 0 || !signbit(d)))
+            return encodeInt32(i);
+    }
+
+    uint64_t bits;
+    if (JS_UNLIKELY(d != d))
+        bits = CANONICAL_NAN;
+    else
+        memcpy(&bits, &d, sizeof(bits));
+    return bits + NUMBER_OFFSET;
+}
+
+inline double decodeNumber (uint64_t bits)
+{
+    if (isInt32(bits))
+        return decodeInt32(bits);
+    double d;
+    bits -= NUMBER_OFFSET;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+inline uint64_t encodeTag (unsigned tag)
+{
+    return (uint64_t)tag << PAYLOAD_BITS;
+}
+
+struct TagField
+{
+    uint64_t bits;
+
+    operator unsigned () const
+    {
+        return bits >= NUMBER_OFFSET ? (unsigned)VT_NUMBER : (unsigned)(bits >> PAYLOAD_BITS);
+    }
+    /** Replace the value with the one of this type without a payload (a number becomes 0) */
+    TagField & operator= (unsigned tag)
+    {
+        bits = encodeTag(tag);
+        return *this;
+    }
+};
+
+struct NumberField
+{
+    uint64_t bits;
+
+    operator double () const
+    {
+        return decodeNumber(bits);
+    }
+    NumberField & operator= (double d)
+    {
+        bits = encodeNumber(d);
+        return *this;
+    }
+};
+
+/** Valid only if the number is stored as int32 */
+struct Int32Field
+{
+    uint64_t bits;
+
+    operator int32_t () const
+    {
+        return decodeInt32(bits);
+    }
+    Int32Field & operator= (int32_t i)
+    {
+        bits = encodeInt32(i);
+        return *this;
+    }
+};
+
+struct BoolField
+{
+    uint64_t bits;
+
+    operator bool () const
+    {
+        return (bits & 1) != 0;
+    }
+    BoolField & operator= (bool b)
+    {
+        bits = (bits & ~PAYLOAD_MASK) | b;
+        return *this;
+    }
+};
+
+template <class T>
+struct PtrField
+{
+    uint64_t bits;
+
+    T * get () const
+    {
+        return reinterpret_cast<T *>((uintptr_t)(bits & PAYLOAD_MASK));
+    }
+    operator T * () const
+    {
+        return get();
+    }
+    T * operator-> () const
+    {
+        return get();
+    }
+    /** Allow casts to a derived class */
+    template <class U>
+    explicit operator U * () const
+    {
+        return static_cast<U *>(get());
+    }
+    PtrField & operator= (T * p)
+    {
+        assert(((uint64_t)(uintptr_t)p & ~PAYLOAD_MASK) == 0);
+        bits = (bits & ~PAYLOAD_MASK) | (uintptr_t)p;
+        return *this;
+    }
+};
+}; // namespace box
+
+union RawValue
+{
+    box::NumberField nval;
+    box::Int32Field ival;
+    box::BoolField bval;
+    box::PtrField<Object> oval;
+    box::PtrField<Function> fval;
+    box::PtrField<StringPrim> sval;
+    box::PtrField<Memory> mval;
+};
+
 inline bool isValueTagPointer (unsigned t)
 {
     return t >= VT_STRINGPRIM;
@@ -101,20 +273,61 @@ inline bool isValueTagObject (unsigned t)
     return t == VT_OBJECT;
 }
 
+/**
+ * Bits describing the position of a class in the hierarchy, stored in every Memory block
+ */
+enum ClassBits
+{
+    CLS_OBJECT = 0x01, CLS_NATIVE = 0x02, CLS_INDEXED = 0x04, CLS_ARRAY_BASE = 0x08, CLS_FUNCTION = 0x10,
+};
+
 struct TaggedValue
 {
-    unsigned tag;
-    RawValue raw;
+    union
+    {
+        uint64_t bits;
+        box::TagField tag;
+        RawValue raw;
+    };
+
+    static TaggedValue fromBits (uint64_t bits)
+    {
+        TaggedValue v;
+        v.bits = bits;
+        return v;
+    }
+    static TaggedValue fromTag (unsigned tag)
+    {
+        return fromBits(box::encodeTag(tag));
+    }
+
+    /** A number stored as int32, so raw.ival can be used */
+    bool isInt32 () const
+    {
+        return box::isInt32(this->bits);
+    }
 };
 
+static_assert(sizeof(TaggedValue) == 8, "TaggedValue must fit in a register");
+
 Memory * allocate (size_t size, StackFrame * caller);
 
 void forceGC (StackFrame * caller);
 
 void _release (Memory * p, Runtime * runtime);
 
-#define JS_UNDEFINED_VALUE  js::TaggedValue{js::VT_UNDEFINED}
-#define JS_NULL_VALUE       js::TaggedValue{js::VT_NULL}
+/**
+ * Allocate a malloc() buffer owned by a heap object, for example the characters of a flattened rope. It is
+ * counted in the heap size, so it brings the next collection closer, but never collects by itself: it may be
+ * called while raw pointers into the heap are live, or during a collection. Returns NULL on failure.
+ */
+void * allocateExternal (size_t size);
+/** Free a buffer returned by allocateExternal() */
+void releaseExternal (void * p, size_t size);
+
+#define JS_UNDEFINED_VALUE  js::TaggedValue::fromTag(js::VT_UNDEFINED)
+#define JS_NULL_VALUE       js::TaggedValue::fromTag(js::VT_NULL)
+#define JS_ARRAY_HOLE_VALUE js::TaggedValue::fromTag(js::VT_ARRAY_HOLE)
 
 struct IMark
 {
@@ -130,6 +343,13 @@ struct Memory
 
     mutable uintptr_t header; //< used by GC
     unsigned gcSize;
+    uint8_t icls;    //< InternalClass, set by the constructors
+    uint8_t clsBits; //< ClassBits, set by the constructors
+
+    Memory () :
+        icls(ICLS_MEMORY),
+        clsBits(0)
+    {}
 
     Memory * getNext () const
     {
@@ -141,7 +361,16 @@ struct Memory
         header = (uintptr_t)next | (header & FLAGS_MASK);
     }
 
-    virtual InternalClass getInternalClass () const;
+    InternalClass getInternalClass () const
+    {
+        return (InternalClass)this->icls;
+    }
+
+    bool hasClassBits (unsigned bits) const
+    {
+        return (this->clsBits & bits) == bits;
+    }
+
     virtual bool mark (IMark * marker, unsigned markBit) const = 0;
 
     virtual void finalizer ();
@@ -222,7 +451,7 @@ struct ListEntry
 
 struct Property : public ListEntry
 {
-    const StringPrim * const name;
+    const StringPrim * name; //< NULL in a deleted inline slot
     unsigned flags;
     TaggedValue value;
 
@@ -244,30 +473,157 @@ enum ObjectFlags
     OF_NOWRITE  = 4,  // property values cannot be modified
 
     OF_INDEX_PROPERTIES = 8, // Index-like properties (e.g. "0", "1", etc) have been defined using defineOwnProperty
+    OF_PROTOTYPE = 16, // The object is the parent of another object, so it participates in the property cache
+    OF_LAZY_PROPS = 32, // A function whose standard properties haven't been created yet, see Function::initLazy()
+};
+
+/**
+ * Storage for the array-index properties of a plain object, so that accessing them by number doesn't need to
+ * convert the index to a string. Only ordinary data properties (writable, enumerable and configurable) are kept
+ * here; index-like properties with other attributes are kept by name and the object is marked with
+ * OF_INDEX_PROPERTIES. An index is never present in both places.
+ *
+ * The elements are kept in a vector while it is at least half full, and in a hash table after that.
+ */
+struct ObjectElements
+{
+    enum { MIN_DENSE_LENGTH = 16 };
+
+    /** Missing elements are VT_ARRAY_HOLE */
+    std::vector<TaggedValue> dense;
+    std::unordered_map<uint32_t, TaggedValue> sparse;
+    /** Number of existing elements */
+    uint32_t count;
+    bool isSparse;
+
+    ObjectElements () :
+        count(0),
+        isSparse(false)
+    {}
+
+    TaggedValue * find (uint32_t index)
+    {
+        if (JS_LIKELY(!this->isSparse))
+            return index < this->dense.size() && this->dense[index].tag != VT_ARRAY_HOLE ? &this->dense[index] : NULL;
+        auto it = this->sparse.find(index);
+        return it != this->sparse.end() ? &it->second : NULL;
+    }
+
+    /** Add an element which must not already exist */
+    void add (uint32_t index, TaggedValue value);
+    void erase (uint32_t index);
+    /** Append the existing indexes in ascending order */
+    void getIndexes (std::vector<uint32_t> & res) const;
+    bool mark (IMark * marker, unsigned markBit) const;
+};
+
+/**
+ * Feedback from an object allocation site in generated code. Objects created at the site record how many
+ * properties they end up with, so that later objects can reserve that many inline property slots.
+ */
+struct AllocSite
+{
+    unsigned slotCount;
+};
+
+/**
+ * Static description of an object literal in generated code, which has only data properties with distinct
+ * names which are not array indexes. The names are indexes into the string table of the module, because the
+ * strings themselves are created at startup.
+ */
+struct ObjectBoilerplate
+{
+    AllocSite site;
+    unsigned count;
+    const unsigned * names;
+    const StringPrim * const * strings;
+};
+
+/**
+ * Static description of an array literal in generated code whose elements are all constants. The arrays
+ * created from it share the elements copy-on-write. String elements are stored at startup, after the string
+ * table of the module has been created.
+ */
+struct ArrayBoilerplate
+{
+    uint32_t length;
+    uint32_t holeCount;
+    bool numbersOnly;
+    const TaggedValue * elems;
+};
+
+/**
+ * Cache of an 'instanceof' site in generated code. The parent of an object never changes after it has been
+ * created, so the result is determined only by the parent of the instance and the prototype of the function.
+ * The entry is valid only until the next GC, which could reuse the addresses.
+ */
+struct InstanceOfSite
+{
+    const Object * parent;
+    const Object * prototype;
+    unsigned gcEpoch;
+    bool result;
 };
 
 struct Object : public Memory
 {
+    enum { MAX_INLINE_SLOTS = 16 };
+
     unsigned flags;
+    /** Incremented whenever an own property is added, deleted or changes its enumerability */
+    unsigned propVersion;
     Object * parent;
     std::map<const char *, Property, less_cstr> props;
     ListEntry propList; // We need to be able to enumerate properties in insertion order
+    AllocSite * allocSite; //< where this object was created, or NULL
+    ObjectElements * elements; //< array-index properties, allocated on demand. Never used by IndexedObject
+    /** The enumerable names of the last descendant enumerated with for-in, see {@link #getEnumCache} */
+    EnumCache * enumCache;
+    /** Number of property slots allocated inline after the end of the object, and how many have been used */
+    unsigned inlineCapacity, inlineUsed;
 
     Object (Object * parent) :
         flags(0),
-        parent(parent)
+        propVersion(0),
+        parent(parent),
+        allocSite(NULL),
+        elements(NULL),
+        enumCache(NULL),
+        inlineCapacity(0),
+        inlineUsed(0)
     {
+        this->icls = ICLS_OBJECT;
+        this->clsBits = CLS_OBJECT;
         this->propList.init();
+        if (parent)
+            parent->flags |= OF_PROTOTYPE;
     }
 
+    virtual ~Object ();
+
     inline void init (StackFrame *) {}
 
-    virtual InternalClass getInternalClass () const;
-    virtual Object * createDescendant (StackFrame * caller);
+    /**
+     * Create a plain object, reserving inline property slots based on the feedback of the allocation site
+     */
+    static Object * make (StackFrame * caller, Object * parent, AllocSite * site);
+
+    virtual Object * createDescendant (StackFrame * caller, AllocSite * site = NULL);
     virtual ForInIterator * makeIterator (StackFrame * caller);
 
     virtual bool mark (IMark * marker, unsigned markBit) const;
 
+    Property * inlineSlots ()
+    {
+        return reinterpret_cast<Property *>(this + 1);
+    }
+
+    /**
+     * Add a new own property, which must not already exist. Extensibility is not checked.
+     * @param name must be interned
+     */
+    Property * addOwnProperty (StackFrame * caller, const StringPrim * name, unsigned flags, TaggedValue value);
+
     bool defineOwnPropertyExplicit (
         StackFrame * caller, const StringPrim * name, unsigned flags, TaggedValue value
     );
@@ -278,12 +634,19 @@ struct Object : public Memory
         StackFrame * caller, const StringPrim * name, unsigned flags, TaggedValue value = JS_UNDEFINED_VALUE
     );
 
+    /**
+     * Create the properties whose creation was deferred (see OF_LAZY_PROPS). This must be called before
+     * looking up or modifying the own properties of the object.
+     */
+    inline void ensureProps (StackFrame * caller);
+
     Property * getOwnProperty (const StringPrim * name);
     Property * getProperty (const StringPrim * name, Object ** propObj);
-    bool hasOwnProperty (const StringPrim * name)
-    {
-        return getOwnProperty(name) != NULL;
-    }
+    /**
+     * Lookup a property in 'start' and its ancestors, going through the runtime property cache.
+     */
+    static Property * getInheritedProperty (Object * start, const StringPrim * name, Object ** propObj);
+    inline bool hasOwnProperty (const StringPrim * name);
     bool hasProperty (const StringPrim * name);
     TaggedValue getPropertyValue (StackFrame * caller, Property * p);
 
@@ -313,8 +676,32 @@ struct Object : public Memory
     bool deleteProperty (StackFrame * caller, const StringPrim * name);
     virtual bool deleteComputed (StackFrame * caller, TaggedValue propName);
 
+    /**
+     * Look for an element in this object and (unless 'own') its ancestors, without converting the index to a
+     * string.
+     * @return 1 - found (*pv points to it), 0 - doesn't exist, -1 - unknown, because an object in the chain could
+     *   have an index-like named property
+     */
+    int findElement (uint32_t index, bool own, TaggedValue ** pv);
+    /**
+     * Look for an index-like property by name and as an element in this object and (unless 'own')
+     * its ancestors.
+     * @return 0 - no property, 1 - named property (*desc), 2 - an element of *propObj (*desc is null)
+     */
+    int findIndexProperty (const StringPrim * name, uint32_t index, bool own, Object ** propObj, Property ** desc);
+    void addElement (StackFrame * caller, uint32_t index, TaggedValue v);
+    bool deleteElement (StackFrame * caller, uint32_t index);
+
     virtual Array * ownKeys (StackFrame * caller);
 
+    /**
+     * Return the names enumerated by for-in, with the own names first. Elements of plain objects are included,
+     * but not the indexed properties of IndexedObject.
+     * The result is shared with the siblings of this object which have exactly the same own properties, so it
+     * must not be modified.
+     */
+    EnumCache * getEnumCache (StackFrame * caller);
+
     virtual uintptr_t getInternalProp (unsigned index) const;
     virtual void setInternalProp (unsigned index, uintptr_t value);
 
@@ -335,6 +722,23 @@ struct Object : public Memory
 
     virtual TaggedValue defaultValue (StackFrame * caller, ValueTag preferredType);
 
+private:
+    Object (Object * parent, AllocSite * site, unsigned inlineCapacity) :
+        flags(0),
+        propVersion(0),
+        parent(parent),
+        allocSite(site),
+        elements(NULL),
+        enumCache(NULL),
+        inlineCapacity(inlineCapacity),
+        inlineUsed(0)
+    {
+        this->icls = ICLS_OBJECT;
+        this->clsBits = CLS_OBJECT;
+        this->propList.init();
+        if (parent)
+            parent->flags |= OF_PROTOTYPE;
+    }
 };
 
 template<class BASE, class TOCREATE>
@@ -342,7 +746,7 @@ struct PrototypeCreator : public BASE
 {
     PrototypeCreator (Object * parent): BASE(parent) {}
 
-    virtual Object * createDescendant (StackFrame * caller);
+    virtual Object * createDescendant (StackFrame * caller, AllocSite * site = NULL);
 };
 
 
@@ -363,18 +767,19 @@ typedef void (*NativeFinalizerFn)(StackFrame *, NativeObject*);
 class NativeObject : public Object
 {
     typedef Object super;
-    InternalClass icls;
     Object * initTag;
     NativeFinalizerFn nativeFinalizer;
     unsigned const internalCount;
     uintptr_t internalProps[1];
 public:
+    enum { CLASS_BITS = CLS_NATIVE };
+    /** The class which declared CLASS_BITS. Derived classes inherit both. */
+    typedef NativeObject ClassBitsOwner;
 
     static NativeObject * make (StackFrame * caller, Object * parent, unsigned internalPropCount);
     static NativeObject * make (StackFrame * caller, unsigned internalPropCount);
 
-    virtual InternalClass getInternalClass () const;
-    virtual Object * createDescendant (StackFrame * caller);
+    virtual Object * createDescendant (StackFrame * caller, AllocSite * site = NULL);
     virtual bool mark (IMark * marker, unsigned markBit) const;
     virtual uintptr_t getInternalProp (unsigned index) const;
     virtual void setInternalProp (unsigned index, uintptr_t value);
@@ -394,7 +799,7 @@ public:
     void setInternalClass (InternalClass icls)
     {
         if (icls != ICLS_OBJECT && this->icls == ICLS_OBJECT)
-            this->icls = icls;
+            this->icls = (uint8_t)icls;
     }
 
     void setNativeFinalizer (NativeFinalizerFn finalizer)
@@ -432,9 +837,14 @@ class IndexedObject : public Object
 {
     typedef Object super;
 public:
+    enum { CLASS_BITS = CLS_INDEXED };
+    typedef IndexedObject ClassBitsOwner;
+
     IndexedObject (Object * parent) :
         Object(parent)
-    {}
+    {
+        this->clsBits |= CLS_INDEXED;
+    }
 
     virtual ForInIterator * makeIterator (StackFrame * caller);
 
@@ -453,46 +863,234 @@ public:
     virtual TaggedValue getAtIndex (StackFrame * caller, uint32_t index) const = 0;
     virtual bool setAtIndex (StackFrame * caller, uint32_t index, TaggedValue value) = 0;
     virtual bool deleteAtIndex (uint32_t index) = 0;
+    /**
+     * Find the first existing index which is not less than 'from'.
+     * @return the index, or getIndexedLength() if there is none
+     */
+    virtual uint32_t nextIndex (uint32_t from) const;
+};
 
+/**
+ * The element storage of an ArrayBase: a vector which can also drop elements from the front in O(1). The
+ * dropped prefix is left in place and is reclaimed when it exceeds half of the capacity, so removing
+ * elements one by one from the front (a queue) is linear overall.
+ *
+ * <p>The elements can also be a read-only table shared with other arrays (an array literal of constants in
+ * generated code). The table is copied into the vector by the first non-const access, so only the const
+ * accessors are cheap for a shared vector.
+ */
+class ElementVector
+{
+    std::vector<TaggedValue> buf;
+    /** The index of the first element in buf */
+    uint32_t start;
+    /** The size of the shared table */
+    uint32_t sharedSize;
+    /** The shared read-only elements, or NULL */
+    const TaggedValue * shared;
+
+    void unshare ()
+    {
+        if (JS_UNLIKELY(shared != NULL))
+            copyShared();
+    }
+    void copyShared ()
+    {
+        buf.assign(shared, shared + sharedSize);
+        start = 0;
+        shared = NULL;
+        sharedSize = 0;
+    }
+public:
+    ElementVector () :
+        start(0),
+        sharedSize(0),
+        shared(NULL)
+    {}
+
+    /** Use the elements of a table which outlives this vector, until the first modification */
+    void share (const TaggedValue * table, uint32_t size)
+    {
+        release();
+        shared = table;
+        sharedSize = size;
+    }
+    bool isShared () const { return shared != NULL; }
+
+    uint32_t size () const { return JS_LIKELY(!shared) ? buf.size() - start : sharedSize; }
+    bool empty () const { return size() == 0; }
+
+    TaggedValue * data () { unshare(); return buf.data() + start; }
+    const TaggedValue * data () const { return JS_LIKELY(!shared) ? buf.data() + start : shared; }
+    TaggedValue * begin () { return data(); }
+    const TaggedValue * begin () const { return data(); }
+    TaggedValue * end () { unshare(); return buf.data() + buf.size(); }
+    const TaggedValue * end () const { return data() + size(); }
+
+    TaggedValue & operator[] (uint32_t index) { unshare(); return buf[start + index]; }
+    const TaggedValue & operator[] (uint32_t index) const { return data()[index]; }
+
+    /** Resize, filling new elements with undefined */
+    void resize (uint32_t newSize)
+    {
+        if (shared && newSize <= sharedSize)
+            sharedSize = newSize;
+        else {
+            unshare();
+            buf.resize(start + newSize);
+        }
+    }
+    void resize (uint32_t newSize, TaggedValue v)
+    {
+        if (shared && newSize <= sharedSize)
+            sharedSize = newSize;
+        else {
+            unshare();
+            buf.resize(start + newSize, v);
+        }
+    }
+    void reserve (uint32_t n) { unshare(); buf.reserve(start + n); }
+    void push_back (TaggedValue v) { unshare(); buf.push_back(v); }
+    void append (const TaggedValue * from, const TaggedValue * to) { unshare(); buf.insert(buf.end(), from, to); }
+
+    void assign (const TaggedValue * from, const TaggedValue * to)
+    {
+        shared = NULL;
+        sharedSize = 0;
+        start = 0;
+        buf.assign(from, to);
+    }
+
+    /** Free the storage */
+    void release ()
+    {
+        shared = NULL;
+        sharedSize = 0;
+        start = 0;
+        std::vector<TaggedValue>().swap(buf);
+    }
+
+    /** Remove the first 'count' elements */
+    void dropFront (uint32_t count)
+    {
+        assert(count <= size());
+        if (JS_UNLIKELY(shared != NULL)) {
+            shared += count;
+            sharedSize -= count;
+            return;
+        }
+        start += count;
+        if (JS_UNLIKELY(start > buf.capacity() / 2)) {
+            buf.erase(buf.begin(), buf.begin() + start);
+            start = 0;
+        }
+    }
 };
 
+/**
+ * An object whose elements are kept in a vector.
+ *
+ * <p>Two facts about the elements (the "element kind") are tracked to enable fast paths:
+ * <ul>
+ * <li>{@link #holeCount} is an upper bound of the number of holes. When it is 0 the array is packed.
+ * Code writing directly into {@link #elems} may only replace holes, so the bound remains valid.</li>
+ * <li>{@link #numbersOnly} is set when all elements which are not holes are numbers, so the GC doesn't need
+ * to look at them. It is only ever set for arrays created from JavaScript, which are always modified
+ * through {@link #setElem} and {@link #copyElems}, and is cleared for good by the first other value.</li>
+ * </ul>
+ *
+ * <p>An array whose length grows far beyond the number of its elements switches to a sparse
+ * representation: only the existing elements are kept in {@link #sparse}, ordered by index, and
+ * {@link #elems} is empty. It switches back when at least half of the indexes are populated. Code which
+ * accesses {@link #elems} directly must check {@link #isSparse} first, unless it created the array itself
+ * with a known small length.
+ */
 class ArrayBase : public IndexedObject
 {
     typedef IndexedObject super;
 public:
-    std::vector<TaggedValue> elems;
+    ElementVector elems;
+    /** An upper bound of the number of holes in {@link #elems} */
+    uint32_t holeCount;
+    /** All elements which are not holes are numbers */
+    bool numbersOnly;
+    /** The length of a sparse array */
+    uint32_t sparseLength;
+    /** The elements of a sparse array, or NULL */
+    std::map<uint32_t, TaggedValue> * sparse;
+
+    enum { CLASS_BITS = CLS_INDEXED | CLS_ARRAY_BASE };
+    typedef ArrayBase ClassBitsOwner;
+    /** Growing an array switches it to sparse if it would end up with more holes than this and than elements */
+    enum : uint32_t { SPARSE_MIN_HOLES = 64 * 1024 };
 
     ArrayBase (Object * parent):
-        IndexedObject(parent)
-    {}
+        IndexedObject(parent),
+        holeCount(0),
+        numbersOnly(false),
+        sparseLength(0),
+        sparse(NULL)
+    {
+        this->clsBits |= CLS_ARRAY_BASE;
+    }
 
+    virtual ~ArrayBase ();
     virtual bool mark (IMark * marker, unsigned markBit) const;
 
-    uint32_t getLength () const { return elems.size(); }
+    bool isSparse () const { return sparse != NULL; }
+
+    uint32_t getLength () const { return JS_LIKELY(!sparse) ? elems.size() : sparseLength; }
 
     void setLength (unsigned newLen);
 
+    /** There are no holes */
+    bool isPacked () const { return holeCount == 0; }
+    /** There are no holes and all elements are numbers */
+    bool isPackedNumbers () const { return numbersOnly && holeCount == 0; }
+
     bool hasElem (unsigned index) const
     {
-        return index < elems.size() && elems[index].tag != VT_ARRAY_HOLE;
+        if (JS_LIKELY(!sparse))
+            return index < elems.size() && elems[index].tag != VT_ARRAY_HOLE;
+        return sparse->find(index) != sparse->end();
     }
 
     TaggedValue getElem (unsigned index) const
     {
         if (index < elems.size()) {
             const TaggedValue * pe = &elems[index];
-            if (pe->tag != VT_ARRAY_HOLE)
+            if (JS_LIKELY(isPacked()) || pe->tag != VT_ARRAY_HOLE)
                 return *pe;
+        } else if (JS_UNLIKELY(sparse != NULL)) {
+            auto it = sparse->find(index);
+            if (it != sparse->end())
+                return it->second;
         }
         return JS_UNDEFINED_VALUE;
     }
     void setElem (unsigned index, TaggedValue v);
 
+    /**
+     * Copy the elements [srcFrom, srcTo) of src (which may be this) to destIndex. The destination range
+     * must already exist.
+     */
+    void copyElems (uint32_t destIndex, const ArrayBase * src, uint32_t srcFrom, uint32_t srcTo);
+    /** Append the values at the end, like push() */
+    void append (const TaggedValue * values, unsigned count);
+    /** Remove the first 'count' elements, shifting the rest down, like shift() */
+    void removeFront (uint32_t count);
+
     virtual uint32_t getIndexedLength () const;
     virtual bool hasIndex (uint32_t index) const;
     virtual TaggedValue getAtIndex (StackFrame * caller, uint32_t index) const;
     virtual bool setAtIndex (StackFrame * caller, uint32_t index, TaggedValue value);
     virtual bool deleteAtIndex (uint32_t index);
+    virtual uint32_t nextIndex (uint32_t from) const;
+
+private:
+    void makeSparse ();
+    void makeDense ();
+    void setSparseElem (unsigned index, TaggedValue v);
 };
 
 class Array : public ArrayBase
@@ -501,10 +1099,11 @@ class Array : public ArrayBase
 public:
     Array (Object * parent):
         ArrayBase(parent)
-    {}
+    {
+        this->icls = ICLS_ARRAY;
+    }
 
     void init (StackFrame * caller);
-    virtual InternalClass getInternalClass () const;
 
     static Array * findArrayInstance (StackFrame * caller, TaggedValue thisp);
     static TaggedValue lengthGetter (StackFrame * caller, Env * env, unsigned argc, const TaggedValue * argv);
@@ -517,27 +1116,54 @@ class Arguments : public ArrayBase
 public:
     Arguments (Object * parent):
         ArrayBase(parent)
-    {}
+    {
+        this->icls = ICLS_ARGUMENTS;
+    }
 
     void init (StackFrame * caller, int argc, const TaggedValue * argv);
-    virtual InternalClass getInternalClass () const;
+};
+
+/**
+ * The names of the enumerable properties of an object and its ancestors, as enumerated by for-in.
+ */
+struct EnumCache : public Memory
+{
+    /** Value of Runtime::protoEpoch when the inherited names were collected */
+    unsigned protoEpoch;
+    /** Number of own names at the beginning of {@link #names} */
+    unsigned ownCount;
+    /** Some of the names are elements, which can't be looked up with {@link Object#getProperty} */
+    bool hasElements;
+    std::vector<const StringPrim *> names;
+
+    EnumCache () :
+        protoEpoch(0),
+        ownCount(0),
+        hasElements(false)
+    {}
+
+    virtual bool mark (IMark * marker, unsigned markBit) const;
+
+    /** Check whether the own properties of the object are exactly the own names */
+    bool matchesOwn (const Object * obj) const;
 };
 
 class ForInIterator : public Memory
 {
     typedef Memory super;
 public:
-    typedef std::vector<const StringPrim *>::const_iterator NameIterator;
-
     /** The object we are enumerating */
     Object * m_obj;
     /** The property names to be enumerated */
-    std::vector<const StringPrim *> m_propNames;
+    EnumCache * m_names;
     /* The next property to be enumerated */
-    NameIterator m_curName;
+    unsigned m_curName;
+    /** If these are unchanged, the remaining names are known to be valid without looking them up */
+    unsigned m_objVersion, m_protoEpoch;
 
     ForInIterator ():
-        m_obj(NULL)
+        m_obj(NULL),
+        m_names(NULL)
     {}
 
     virtual bool mark (IMark * marker, unsigned markBit) const;
@@ -571,19 +1197,47 @@ public:
     unsigned length; //< number of argumenrs
     CodePtr code;
     CodePtr consCode;
+    const StringPrim * lazyName; //< the value of 'name' while OF_LAZY_PROPS is set
+    /**
+     * The own 'prototype' property, once it has been looked up, if it is a non-configurable data property,
+     * so it can never be deleted or become an accessor
+     */
+    Property * protoProp;
+
+    enum { CLASS_BITS = CLS_FUNCTION };
+    typedef Function ClassBitsOwner;
 
     Function (Object * parent):
-        Object(parent), env(NULL), length(0), code(NULL)
-    {}
+        Object(parent), env(NULL), length(0), code(NULL), consCode(NULL), lazyName(NULL), protoProp(NULL)
+    {
+        this->icls = ICLS_FUNCTION;
+        this->clsBits |= CLS_FUNCTION;
+    }
     void init (StackFrame * caller, Env * env, CodePtr code, CodePtr consCode, const StringPrim * name, unsigned length);
+    /**
+     * Initialize a function without creating any properties. The standard properties and the
+     * prototype object are created by {@link #materializeProps} the first time the own properties of
+     * the function are accessed, which most closures never need.
+     */
+    void initLazy (Env * env, CodePtr code, CodePtr consCode, const StringPrim * name, unsigned length)
+    {
+        this->env = env;
+        this->code = code;
+        this->consCode = consCode;
+        this->length = length;
+        this->lazyName = name;
+        this->flags |= OF_LAZY_PROPS;
+    }
+    void materializeProps (StackFrame * caller);
+    /** Check whether 'name' is one of the properties created by {@link #materializeProps} */
+    static bool isLazyPropName (const StringPrim * name);
 
-    virtual InternalClass getInternalClass () const;
     virtual bool mark (IMark * marker, unsigned markBit) const;
 
     /** Define the 'prototype' property */
     void definePrototype (StackFrame * caller, Object * prototype, unsigned propsFlags = 0);
 
-    bool hasInstance (StackFrame * caller, Object * inst);
+    bool hasInstance (StackFrame * caller, Object * inst, InstanceOfSite * site = NULL);
 
     virtual TaggedValue call (StackFrame * caller, unsigned argc, const TaggedValue * argv);
     virtual TaggedValue callCons (StackFrame * caller, unsigned argc, const TaggedValue * argv);
@@ -595,7 +1249,7 @@ struct FunctionCreator : public Function
         Function(parent)
     {}
 
-    virtual Object * createDescendant (StackFrame * caller);
+    virtual Object * createDescendant (StackFrame * caller, AllocSite * site = NULL);
 };
 
 class BoundFunction : public Function
@@ -630,38 +1284,106 @@ struct BoundPrototype : public Object
         Object(parent), target(aTarget)
     {}
 
-    virtual Object * createDescendant (StackFrame * caller);
+    virtual Object * createDescendant (StackFrame * caller, AllocSite * site = NULL);
 };
 
+/**
+ * A string primitive. The characters are UTF-8 and normally follow the header in {@link #_str}.
+ *
+ * <p>Two kinds of strings keep an {@link Indirect} record in place of the characters:
+ * <ul>
+ * <li>Long concatenations create ropes (see {@link concatString}): the two parts are referenced and
+ * the characters are only assembled in a separate buffer the first time they are needed. A rope doesn't
+ * keep its parts alive after that.</li>
+ * <li>Long substrings create slices, which point into the characters of their parent and keep it alive.
+ * Substrings much shorter than the string owning the characters are copied instead, so a small slice never
+ * holds on to a large parent.</li>
+ * </ul>
+ *
+ * <p>The characters of a string never move while it is alive, so pointers to them stay valid across
+ * collections. A slice which needs its own copy (see {@link #getStr}) still keeps its parent alive.
+ *
+ * <p>Characters must always be read through {@link #chars} or {@link #getStr}, never through {@link #_str},
+ * which is only for filling in new strings. Only {@link #getStr} guarantees a terminating zero.
+ */
 struct StringPrim : public Memory
 {
     enum {
         F_INTERNED = 1,
         F_PERMANENT = 2,
+        F_INDEX_KNOWN = 4, //< F_INDEX and indexValue have been computed
+        F_INDEX = 8,       //< the string is an array index
+        F_ROPE = 16,       //< a rope: _str contains an Indirect instead of the characters
+        F_HASH_KNOWN = 32, //< hashValue has been computed
+        F_SLICE = 64,      //< a slice: _str contains an Indirect instead of the characters
+        F_SLICE_COPY = 128,//< a slice which owns a copy of its characters
+        F_INDIRECT = F_ROPE | F_SLICE,
+    };
+    enum : unsigned {
+        /** Concatenations shorter than this are copied right away */
+        ROPE_MIN_LENGTH = 256,
+        /** Substrings shorter than this are copied right away */
+        SLICE_MIN_LENGTH = 32,
+        /** Substrings shorter than the owner of the characters divided by this are copied right away */
+        SLICE_MAX_WASTE = 4,
+    };
+
+    struct Indirect
+    {
+        /**
+         * A rope: the left part, or NULL once flattened. A slice: the parent, which owns the characters
+         * unless it is a slice itself with F_SLICE_COPY.
+         */
+        const StringPrim * left;
+        /** A rope: the right part, or NULL once flattened */
+        const StringPrim * right;
+        /** The characters, or NULL while a rope hasn't been flattened. A slice owns them with F_SLICE_COPY. */
+        const unsigned char * chars;
     };
-    mutable unsigned stringFlags;
+
+    /** 16 bits, so it fits in the padding at the end of Memory */
+    mutable uint16_t stringFlags;
     const unsigned byteLength;
     unsigned charLength;
     mutable unsigned lastPos;
     mutable unsigned lastIndex;
+    mutable uint32_t indexValue; //< valid if F_INDEX is set
+    mutable uint32_t hashValue;  //< valid if F_HASH_KNOWN is set
     //private:
     unsigned char _str[];
 
     StringPrim (unsigned byteLength) :
         byteLength(byteLength)
     {
+        this->icls = ICLS_STRING_PRIM;
         this->stringFlags = 0;
         this->_str[byteLength] = 0;
         this->lastPos = 0;
         this->lastIndex = 0;
+        this->indexValue = 0;
+        this->hashValue = 0;
 #ifdef JS_DEBUG
         this->charLength = ~0u; // for debugging to show uninitialized
 #endif
     }
 
+    /** Construct a rope or a slice. The allocation must have room for an Indirect after the header */
+    StringPrim (unsigned flags, unsigned byteLength, unsigned charLength, const Indirect & ind) :
+        byteLength(byteLength)
+    {
+        this->icls = ICLS_STRING_PRIM;
+        this->stringFlags = flags;
+        this->charLength = charLength;
+        this->lastPos = 0;
+        this->lastIndex = 0;
+        this->indexValue = 0;
+        this->hashValue = 0;
+        *indirect() = ind;
+    }
+
     void init ()
     {
-        this->charLength = lengthInUTF16Units((const unsigned char *)_str, (const unsigned char *)_str + byteLength);
+        this->charLength = lengthInUTF16Units(_str, _str + byteLength);
     }
     void init (unsigned charLength)
     {
@@ -669,10 +1391,16 @@ struct StringPrim : public Memory
     }
 
     //public:
-    virtual InternalClass getInternalClass () const;
+    virtual ~StringPrim ();
     virtual bool mark (IMark * marker, unsigned markBit) const;
 
     static StringPrim * makeEmpty (StackFrame * caller, unsigned length);
+    /** Create a rope of two non-empty strings */
+    static StringPrim * makeRope (StackFrame * caller, const StringPrim * left, const StringPrim * right);
+    /** Create a slice of the valid UTF-8 at byte 'offset' of 'parent', which must be rooted */
+    static StringPrim * makeSlice (
+        StackFrame * caller, const StringPrim * parent, unsigned offset, unsigned length, unsigned charLength
+    );
     static StringPrim * makeFromValid (StackFrame * caller, const char * str, unsigned length, unsigned charLength);
     static StringPrim * makeFromValid (StackFrame * caller, const char * str, unsigned length);
     static StringPrim * makeFromValid (StackFrame * caller, const char * str)
@@ -699,9 +1427,45 @@ struct StringPrim : public Memory
 
     bool isInterned () const { return (this->stringFlags & F_INTERNED) != 0; }
 
+    /**
+     * Check whether the string is an array index. The result is computed the first time and cached.
+     */
+    bool isIndex (uint32_t * index) const
+    {
+        if (JS_UNLIKELY(!(this->stringFlags & F_INDEX_KNOWN)))
+            computeIndex();
+        *index = this->indexValue;
+        return (this->stringFlags & F_INDEX) != 0;
+    }
+    void computeIndex () const;
+
+    /** The hash of the characters, computed the first time and cached */
+    uint32_t hash () const
+    {
+        if (JS_UNLIKELY(!(this->stringFlags & F_HASH_KNOWN)))
+            computeHash();
+        return this->hashValue;
+    }
+    void computeHash () const;
+    static uint32_t hashChars (const unsigned char * str, unsigned length);
+
+    bool isRope () const { return (this->stringFlags & F_ROPE) != 0; }
+    bool isSlice () const { return (this->stringFlags & F_SLICE) != 0; }
+
+    /** The characters, which are zero terminated except in slices. A rope is flattened the first time. */
+    const unsigned char * chars () const
+    {
+        if (JS_UNLIKELY(this->stringFlags & F_INDIRECT))
+            return indirectChars();
+        return this->_str;
+    }
+
+    /** The characters, zero terminated. A slice which isn't gets a copy of its characters. */
     const char * getStr () const
     {
-        return (const char *)this->_str;
+        if (JS_UNLIKELY(isSlice()))
+            return sliceStr();
+        return (const char *)chars();
     }
 
     /**
@@ -736,6 +1500,27 @@ struct StringPrim : public Memory
     TaggedValue byteSubstring (StackFrame * caller, uint32_t from, uint32_t to) const;
 
     static unsigned lengthInUTF16Units (const unsigned char * from, const unsigned char * to);
+
+private:
+    Indirect * indirect () const
+    {
+        return (Indirect *)this->_str;
+    }
+    const unsigned char * indirectChars () const
+    {
+        const Indirect * ind = indirect();
+        if (JS_UNLIKELY(ind->chars == NULL))
+            flatten();
+        return ind->chars;
+    }
+    void flatten () const;
+    const char * sliceStr () const;
+    /** Give a slice its own zero-terminated copy of the characters */
+    bool copySlice () const;
+    /** Whether a substring of this length should share the characters instead of copying them */
+    bool shouldSlice (unsigned length) const;
+
+    friend struct Runtime;
 };
 
 struct less_StringPrim {
@@ -768,8 +1553,9 @@ class Number : public Box
 public:
     Number (Object * parent, TaggedValue value = JS_UNDEFINED_VALUE) :
         Box(parent, value)
-    {}
-    virtual InternalClass getInternalClass () const;
+    {
+        this->icls = ICLS_NUMBER;
+    }
 };
 
 class Boolean : public Box
@@ -777,9 +1563,10 @@ class Boolean : public Box
 public:
     Boolean (Object * parent, TaggedValue value = JS_UNDEFINED_VALUE) :
         Box(parent, value)
-    {}
+    {
+        this->icls = ICLS_BOOLEAN;
+    }
 
-    virtual InternalClass getInternalClass () const;
 };
 
 class String : public IndexedObject
@@ -790,7 +1577,9 @@ public:
 
     String (Object * parent, TaggedValue value = JS_UNDEFINED_VALUE) :
         IndexedObject(parent), value(value)
-    {}
+    {
+        this->icls = ICLS_STRING;
+    }
 
     const StringPrim * getStrPrim () const
     {
@@ -802,7 +1591,6 @@ public:
         this->value = value;
     }
 
-    virtual InternalClass getInternalClass () const;
     virtual bool mark (IMark * marker, unsigned markBit) const;
     virtual TaggedValue defaultValue (StackFrame * caller, ValueTag preferredType);
 
@@ -817,8 +1605,9 @@ struct Error : public Object
 {
     Error (Object * parent):
         Object(parent)
-    {}
-    virtual InternalClass getInternalClass () const;
+    {
+        this->icls = ICLS_ERROR;
+    }
 };
 
 struct StackFrame
@@ -991,6 +1780,60 @@ struct Handles
     }
 };
 
+/**
+ * The pool of interned strings: an open-addressing hash table with linear probing, using the hash cached
+ * in the strings.
+ *
+ * <p>Growing is incremental. A new table is allocated and the entries of the old one are moved a few at a
+ * time by the following insertions and removals, so no single operation pays for rehashing everything.
+ * Until the move is complete lookups examine both tables.
+ */
+class InternTable
+{
+public:
+    InternTable ();
+
+    /** Find an interned string with these characters, or return NULL */
+    const StringPrim * find (const unsigned char * str, unsigned length, uint32_t hash) const;
+    /** Add a string which is not in the table already */
+    void insert (const StringPrim * str);
+    /** Remove a string which is in the table */
+    void remove (const StringPrim * str);
+
+    uint32_t size () const { return count; }
+
+private:
+    enum : uint32_t { MIN_CAPACITY = 1024, MOVE_STEP = 8 };
+
+    struct Table
+    {
+        std::vector<const StringPrim *> slots;
+        /** Slots which are not empty, including the removed ones */
+        uint32_t used;
+
+        Table () : used(0) {}
+        uint32_t mask () const { return (uint32_t)slots.size() - 1; }
+        const StringPrim ** findSlot (const StringPrim * str);
+        void add (const StringPrim * str);
+    };
+
+    Table cur;
+    /** The table being moved to 'cur', or empty */
+    Table old;
+    /** The next slot of 'old' to move */
+    uint32_t movePos;
+    /** Entries remaining in 'old' */
+    uint32_t oldCount;
+    uint32_t count;
+
+    /** Marks removed slots, so probing continues past them */
+    static const StringPrim * removed () { return reinterpret_cast<const StringPrim *>((uintptr_t)1); }
+
+    static const StringPrim * find (const Table & t, const unsigned char * str, unsigned length, uint32_t hash);
+    void grow ();
+    void move (uint32_t slotCount);
+};
+
 struct Runtime
 {
     enum
@@ -1041,15 +1884,15 @@ struct Runtime
     _JS_TA_DECL(float64);
 #undef _JS_TA_DECL
 
-    Env * env;
-
-    typedef std::pair<unsigned,const unsigned char*> PasStr;
+    Object * mapPrototype;
+    Function * map;
+    Object * setPrototype;
+    Function * set;
+    Object * collectionIteratorPrototype;
 
-    struct less_PasStr {
-        bool operator() (const PasStr & a, const PasStr & b) const;
-    };
+    Env * env;
 
-    std::map<PasStr,const StringPrim*,less_PasStr> permStrings;
+    InternTable permStrings;
 
     const StringPrim * permStrEmpty;
     const StringPrim * permStrUndefined;
@@ -1074,6 +1917,13 @@ struct Runtime
     const StringPrim * permStrToString;
     const StringPrim * permStrValueOf;
     const StringPrim * permStrMessage;
+    const StringPrim * permStrValue;
+    const StringPrim * permStrDone;
+    const StringPrim * permStrGet;
+    const StringPrim * permStrSet;
+    const StringPrim * permStrWritable;
+    const StringPrim * permStrEnumerable;
+    const StringPrim * permStrConfigurable;
     const StringPrim * permStrUnicodeReplacementChar;
 
     // Pre-allocated ASCII chars for faster substring/charAt/[] in the common case
@@ -1082,6 +1932,44 @@ struct Runtime
 
     Handles handles;
 
+    /**
+     * A direct-mapped cache of inherited property lookups: (first prototype searched, interned name) ->
+     * (holder, property). An entry is valid only while its epoch matches {@link #protoEpoch}, which acts as
+     * the validity cell of all prototype chains at once. It is bumped when a property is added to or deleted from
+     * an object with OF_PROTOTYPE, or changes its enumerability. The cache is cleared after every GC.
+     */
+    struct PropCacheEntry
+    {
+        const Object * start;
+        const StringPrim * name;
+        unsigned epoch;
+        Object * holder;
+        Property * prop; //< NULL if the property wasn't found
+    };
+    enum { PROP_CACHE_SIZE = 1024 };
+    unsigned protoEpoch;
+    PropCacheEntry propCache[PROP_CACHE_SIZE];
+    /** Incremented after every GC, invalidating caches keyed by object addresses, like {@link InstanceOfSite} */
+    unsigned gcEpoch;
+    /**
+     * Equal to {@link #protoEpoch} when Object.prototype was last found not to have any of the property
+     * descriptor fields, so the fields of a literal descriptor are all own, see toPropertyDescriptor()
+     */
+    unsigned descriptorEpoch;
+
+    void invalidatePropCache ()
+    {
+        if (JS_UNLIKELY(++this->protoEpoch == 0)) {
+            clearPropCache();
+            this->protoEpoch = 1;
+        }
+    }
+
+    void clearPropCache ()
+    {
+        memset(this->propCache, 0, sizeof(this->propCache));
+    }
+
     unsigned markBit; // the value that was used for marking during the previous collection
 
     struct MemoryHead : public Memory
@@ -1131,6 +2019,8 @@ private:
     );
 
     void defineMethod (StackFrame * caller, Object * prototype, const char * sname, unsigned length, CodePtr code);
+
+    friend void collectionsInit (StackFrame * caller);
 };
 
 extern Runtime * g_runtime;
@@ -1191,26 +2081,23 @@ inline bool markMemory (IMark * marker, unsigned markBit, const Memory * mem)
 
 inline TaggedValue makeBooleanValue (bool bval)
 {
-    TaggedValue val;
-    val.tag = VT_BOOLEAN;
-    val.raw.bval = bval;
-    return val;
+    return TaggedValue::fromBits(box::encodeTag(VT_BOOLEAN) | bval);
 }
 
 inline TaggedValue makeNumberValue (double dval)
 {
-    TaggedValue val;
-    val.tag = VT_NUMBER;
-    val.raw.nval = dval;
-    return val;
+    return TaggedValue::fromBits(box::encodeNumber(dval));
+}
+
+inline TaggedValue makeInt32Value (int32_t ival)
+{
+    return TaggedValue::fromBits(box::encodeInt32(ival));
 }
 
 inline TaggedValue makeMemoryValue (ValueTag tag, Memory * m)
 {
-    TaggedValue val;
-    val.tag = tag;
-    val.raw.mval = m;
-    return val;
+    assert(((uint64_t)(uintptr_t)m & ~box::PAYLOAD_MASK) == 0);
+    return TaggedValue::fromBits(box::encodeTag(tag) | (uintptr_t)m);
 }
 
 inline TaggedValue makePropertyAccessorValue (PropertyAccessor * pr)
@@ -1268,7 +2155,24 @@ inline TaggedValue makeStringValueFromUnvalidated (StackFrame * caller, const ch
     return makeStringValue(StringPrim::makeFromUnvalidated(caller, str, byteLength));
 }
 
-Object * objectCreate (StackFrame * caller, TaggedValue parent);
+Object * objectCreate (StackFrame * caller, TaggedValue parent, AllocSite * site = NULL);
+/**
+ * Create an object literal with all of its properties, taking the values from 'values'.
+ */
+Object * objectCreateLiteral (StackFrame * caller, TaggedValue parent, ObjectBoilerplate * bp, const TaggedValue * values);
+/**
+ * Create an array literal sharing the elements of 'bp'. 'parent' must be the array prototype.
+ */
+Object * arrayCreateConst (StackFrame * caller, TaggedValue parent, const ArrayBoilerplate * bp);
+/**
+ * Convert a property descriptor object to flags for defineOwnPropertyExplicit() (ES5.1 8.10.5).
+ * @param value receives the value or the accessor, depending on the flags. Must be rooted.
+ */
+unsigned toPropertyDescriptor (StackFrame * caller, TaggedValue desc, TaggedValue * value);
+/** Object.defineProperty() */
+void definePropertyFromDescriptor (StackFrame * caller, Object * obj, const StringPrim * name, TaggedValue desc);
+/** Object.defineProperties() */
+void definePropertiesFromObject (StackFrame * caller, Object * obj, TaggedValue props);
 TaggedValue newFunction (StackFrame * caller, Env * env, const StringPrim * name, unsigned length, CodePtr code);
 
 void throwValue (StackFrame * caller, TaggedValue val) JS_NORETURN;
@@ -1277,8 +2181,8 @@ void throwTypeError (StackFrame * caller, const char * str, ...) JS_NORETURN;
 
 inline NativeObject * isNativeObject (TaggedValue v)
 {
-    // TODO: get rid of this dynamic_cast
-    return isValueTagObject(v.tag) ? dynamic_cast<NativeObject *>(v.raw.oval) : NULL;
+    return isValueTagObject(v.tag) && v.raw.oval->hasClassBits(CLS_NATIVE) ?
+           static_cast<NativeObject *>(v.raw.oval) : NULL;
 }
 
 inline bool checkInitTag (TaggedValue obj, TaggedValue initTag)
@@ -1291,12 +2195,12 @@ inline bool checkInitTag (TaggedValue obj, TaggedValue initTag)
 
 inline Function * isFunction (TaggedValue v)
 {
-    return isValueTagObject(v.tag) && v.raw.oval->getInternalClass() == ICLS_FUNCTION ?
-                static_cast<Function *>(v.raw.oval) : NULL;
+    return isValueTagObject(v.tag) && v.raw.oval->hasClassBits(CLS_FUNCTION) ?
+           static_cast<Function *>(v.raw.oval) : NULL;
 }
 inline Function * isCallable (TaggedValue v)
 {
-    return isValueTagObject(v.tag) && v.raw.oval->getInternalClass() == ICLS_FUNCTION ?
+    return isValueTagObject(v.tag) && v.raw.oval->hasClassBits(CLS_FUNCTION) ?
            static_cast<Function *>(v.raw.oval) : NULL;
 }
 TaggedValue call(StackFrame * caller, TaggedValue value, unsigned argc, const TaggedValue * argv);
@@ -1307,6 +2211,11 @@ TaggedValue callCons(StackFrame * caller, TaggedValue value, unsigned argc, cons
  */
 inline bool isValidArrayIndexNumber (TaggedValue val, uint32_t * index)
 {
+    if (JS_LIKELY(val.isInt32())) {
+        int32_t n = val.raw.ival;
+        *index = n;
+        return n >= 0;
+    }
     if (val.tag == VT_NUMBER) {
         uint32_t n = (uint32_t)val.raw.nval;
         if (n == val.raw.nval && n != UINT32_MAX) {
@@ -1317,6 +2226,9 @@ inline bool isValidArrayIndexNumber (TaggedValue val, uint32_t * index)
     return false;
 }
 
+/**
+ * Checks whether the string is the canonical representation of an array index (0..2**32-2).
+ */
 bool isIndexString (const char * str, uint32_t * index);
 
 InternalClass getInternalClass (TaggedValue v);
@@ -1338,8 +2250,6 @@ inline double toInteger (StackFrame * caller, TaggedValue v)
 {
     return toInteger(toNumber(caller, v));
 }
-uint32_t toUint32 (StackFrame * caller, TaggedValue v);
-int32_t toInt32 (StackFrame * caller, TaggedValue v);
 inline uint32_t toUint32 (double num)
 {
     return isfinite(num) ? (uint32_t)num : 0;
@@ -1348,6 +2258,14 @@ inline int32_t toInt32 (double num)
 {
     return isfinite(num) ? (int32_t)num : 0;
 }
+inline uint32_t toUint32 (StackFrame * caller, TaggedValue v)
+{
+    return JS_LIKELY(v.isInt32()) ? (uint32_t)(int32_t)v.raw.ival : toUint32(toNumber(caller, v));
+}
+inline int32_t toInt32 (StackFrame * caller, TaggedValue v)
+{
+    return JS_LIKELY(v.isInt32()) ? (int32_t)v.raw.ival : toInt32(toNumber(caller, v));
+}
 TaggedValue toString (StackFrame * caller, double n);
 TaggedValue toString (StackFrame * caller, TaggedValue v);
 
@@ -1363,6 +2281,37 @@ double parseInt (StackFrame * caller, const char * s, int radix);
 // Operators
 TaggedValue operator_ADD (StackFrame * caller, TaggedValue a, TaggedValue b);
 
+/**
+ * Numeric addition, staying in int32 while the operands are int32 and the result doesn't overflow
+ */
+inline TaggedValue operator_ADD_N (StackFrame * caller, TaggedValue a, TaggedValue b)
+{
+    int32_t r;
+    if (JS_LIKELY(a.isInt32() && b.isInt32()) && !__builtin_add_overflow((int32_t)a.raw.ival, (int32_t)b.raw.ival, &r))
+        return makeInt32Value(r);
+    return makeNumberValue(toNumber(caller, a) + toNumber(caller, b));
+}
+
+inline TaggedValue operator_SUB_N (StackFrame * caller, TaggedValue a, TaggedValue b)
+{
+    int32_t r;
+    if (JS_LIKELY(a.isInt32() && b.isInt32()) && !__builtin_sub_overflow((int32_t)a.raw.ival, (int32_t)b.raw.ival, &r))
+        return makeInt32Value(r);
+    return makeNumberValue(toNumber(caller, a) - toNumber(caller, b));
+}
+
+inline TaggedValue operator_MUL_N (StackFrame * caller, TaggedValue a, TaggedValue b)
+{
+    int32_t r;
+    // A zero result could be -0, e.g. -1 * 0
+    if (JS_LIKELY(a.isInt32() && b.isInt32()) && !__builtin_mul_overflow((int32_t)a.raw.ival, (int32_t)b.raw.ival, &r) &&
+        (r != 0 || ((int32_t)a.raw.ival | (int32_t)b.raw.ival) >= 0))
+    {
+        return makeInt32Value(r);
+    }
+    return makeNumberValue(toNumber(caller, a) * toNumber(caller, b));
+}
+
 const StringPrim * operator_TYPEOF (StackFrame * caller, TaggedValue a);
 
 bool operator_IF_STRICT_EQ (TaggedValue a, TaggedValue b);
@@ -1372,24 +2321,52 @@ bool operator_IF_LE (StackFrame * caller, TaggedValue x, TaggedValue y);
 bool operator_IF_GT (StackFrame * caller, TaggedValue x, TaggedValue y);
 bool operator_IF_GE (StackFrame * caller, TaggedValue x, TaggedValue y);
 
-inline bool operator_IF_INSTANCEOF (StackFrame * caller, TaggedValue x, Function * y)
+inline bool operator_IF_INSTANCEOF (StackFrame * caller, TaggedValue x, Function * y, InstanceOfSite * site = NULL)
 {
-    return isValueTagObject(x.tag) && y->hasInstance(caller, x.raw.oval);
+    return isValueTagObject(x.tag) && y->hasInstance(caller, x.raw.oval, site);
 }
 
 inline Property * Object::getOwnProperty (const StringPrim * name)
 {
+    if (this->inlineUsed) {
+        Property * p = inlineSlots(), * e = p + this->inlineUsed;
+        // All property names are interned, so usually we can compare the pointers
+        if (JS_LIKELY(name->isInterned())) {
+            for ( ; p != e; ++p )
+                if (p->name == name)
+                    return p;
+        } else {
+            for ( ; p != e; ++p )
+                if (p->name && strcmp(p->name->getStr(), name->getStr()) == 0)
+                    return p;
+        }
+        if (this->props.empty())
+            return NULL;
+    }
     auto it = this->props.find(name->getStr());
     return it != this->props.end() ? &it->second : NULL;
 }
 
+inline void Object::ensureProps (StackFrame * caller)
+{
+    if (JS_UNLIKELY(this->flags & OF_LAZY_PROPS))
+        static_cast<Function *>(this)->materializeProps(caller);
+}
+
+inline bool Object::hasOwnProperty (const StringPrim * name)
+{
+    if (JS_UNLIKELY(this->flags & OF_LAZY_PROPS) && Function::isLazyPropName(name))
+        return true;
+    return getOwnProperty(name) != NULL;
+}
+
 inline TaggedValue Object::getPropertyValue (StackFrame * caller, Property * p)
 {
     if ((p->flags & PROP_GET_SET) == 0) {
         return p->value;
     } else {
         // Invoke the getter
-        if (Function * getter = ((PropertyAccessor *)p->value.raw.oval)->get) {
+        if (Function * getter = ((PropertyAccessor *)p->value.raw.mval)->get) {
             TaggedValue thisp = makeObjectValue(this);
             return (*getter->code)(caller, getter->env, 1, &thisp);
         }
@@ -1435,11 +2412,15 @@ inline T * newInit2 (StackFrame * caller, Object * parent, P1 p1)
 }
 
 template<class BASE, class TOCREATE>
-Object * PrototypeCreator<BASE,TOCREATE>::createDescendant (StackFrame * caller)
+Object * PrototypeCreator<BASE,TOCREATE>::createDescendant (StackFrame * caller, AllocSite *)
 {
     return newInit<TOCREATE>(caller, this);
 };
 
+/** Arrays created from JavaScript start out tracking whether they contain only numbers */
+template<>
+Object * PrototypeCreator<Object,Array>::createDescendant (StackFrame * caller, AllocSite *);
+
 }; // namespace js
 
 #endif //JSCOMP_OBJECTS_H
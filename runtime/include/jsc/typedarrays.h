@@ -22,10 +22,11 @@ public:
         Object(parent),
         byteLength(0),
         data(NULL)
-    {}
+    {
+        this->icls = ICLS_ArrayBuffer;
+    }
 
     virtual ~ArrayBuffer ();
-    virtual InternalClass getInternalClass () const;
 
     void allocateBuffer (StackFrame * caller, double flen);
 
@@ -48,9 +49,10 @@ public:
         byteOffset(0),
         byteLength(0),
         data(NULL)
-    {}
+    {
+        this->icls = ICLS_DataView;
+    }
 
-    virtual InternalClass getInternalClass () const;
 
     virtual bool mark (IMark * marker, unsigned markBit) const;
 
@@ -121,11 +123,8 @@ public:
 
     TypedArray (Object * parent) :
         ArrayBufferView(parent)
-    { }
-
-    virtual InternalClass getInternalClass () const
     {
-        return ICLS;
+        this->icls = ICLS;
     }
 
     virtual TaggedValue getAtIndex (StackFrame * caller, uint32_t index) const
@@ -58,6 +58,22 @@ unsigned utf8Encode (unsigned char * dst, uint32_t codePoint);
 unsigned utf8EncodedLength (uint32_t codePoint);
 unsigned utf8Length (const unsigned char * from, const unsigned char * to);
 
+/**
+ * Return the first byte in [from, to) which is not ASCII, or 'to' if there is none.
+ */
+const unsigned char * utf8SkipASCII (const unsigned char * from, const unsigned char * to);
+
+/**
+ * Check whether [from, to) is well-formed UTF-8 according to the same rules as utf8Decode(): no overlong
+ * forms, no surrogates, nothing above UNICODE_MAX_VALUE and no truncated sequences.
+ */
+bool utf8IsValid (const unsigned char * from, const unsigned char * to);
+
+/**
+ * Return the length in UTF-16 code units of [from, to), which must be valid UTF-8.
+ */
+unsigned utf8LengthInUTF16Units (const unsigned char * from, const unsigned char * to);
+
 /*
  * Decode one utf-8 code point. We always require the input buffer be zero-terminated. That guarantees us safety
  * even when it is invalid (e.g. partial utf-8 sequence). The terminating zero will be an invalid character and
@@ -39,6 +39,9 @@ var ICLS_Int32Array   = 23;
 var ICLS_Uint32Array  = 24;
 var ICLS_Float32Array = 25;
 var ICLS_Float64Array = 26;
+var ICLS_Map = 27;
+var ICLS_Set = 28;
+var ICLS_CollectionIterator = 29;
 
 function getInternalClass (obj)
 {
@@ -157,52 +160,8 @@ function defineProperty (obj, prop, descriptor)
 {
     needObject(obj, "defineProperty()");
 
-    if (descriptor === void 0)
-        descriptor = {};
-
-    if (("get" in descriptor) && typeof descriptor.get !== "function")
-        throw new TypeError("'get' is not a function");
-    if (("set" in descriptor) && typeof descriptor.set !== "function")
-        throw new TypeError("'set' is not a function");
-
-    var value;
-    var haveValue = false;
-    var getset = false;
-    if (descriptor.get || descriptor.set) {
-        if (("value" in descriptor) || ("writable" in descriptor))
-            throw new TypeError("Cannot specify 'value' or 'writable' with get/set");
-
-        getset = true;
-        __asm__({},[],[["get", descriptor.get], ["set", descriptor.set], ["value", value]],[],
-            "%[value] = js::makePropertyAccessorValue(new(%[%frame]) js::PropertyAccessor("+
-            "js::isFunction(%[get]),"+
-            "js::isFunction(%[set])"+
-            "));"
-        );
-    } else {
-        haveValue = "value" in descriptor;
-        value = descriptor.value;
-    }
-
-    __asm__({},[],[
-            ["obj", obj], ["prop", String(prop)],
-            ["haveValue", haveValue],                           ["value", value],
-            ["haveConfigurable", "configurable" in descriptor], ["configurable", !!descriptor.configurable],
-            ["haveEnumerable", "enumerable" in descriptor],     ["enumerable", !!descriptor.enumerable],
-            ["haveWritable", "writable" in descriptor],         ["writable", !!descriptor.writable],
-            ["getset", getset]
-        ],[],
-        "%[obj].raw.oval->defineOwnPropertyExplicitThrowing(%[%frame], %[prop].raw.sval,"+
-        "    (%[haveConfigurable].raw.bval ? js::PROP_HAVE_CONFIGURABLE : 0) |"+
-        "    (%[configurable].raw.bval ? js::PROP_CONFIGURABLE : 0) |"+
-        "    (%[haveEnumerable].raw.bval ? js::PROP_HAVE_ENUMERABLE : 0) |"+
-        "    (%[enumerable].raw.bval ? js::PROP_ENUMERABLE : 0) |"+
-        "    (%[haveWritable].raw.bval ? js::PROP_HAVE_WRITABLE : 0) |"+
-        "    (%[writable].raw.bval ? js::PROP_WRITEABLE : 0) |"+
-        "    (%[getset].raw.bval ? js::PROP_GET_SET : 0) |" +
-        "    (%[haveValue].raw.bval ? js::PROP_HAVE_VALUE : 0),"+
-        "  %[value]"+
-        ");"
+    __asm__({},[],[["obj", obj], ["prop", String(prop)], ["descriptor", descriptor]],[],
+        "js::definePropertyFromDescriptor(%[%frame], %[obj].raw.oval, %[prop].raw.sval, %[descriptor]);"
     );
 
     return obj;
@@ -212,29 +171,62 @@ function defineProperties (obj, props)
 {
     needObject(obj, "defineProperties()");
 
-    for ( var pn in Object(props) )
-        defineProperty(obj, pn, props[pn]);
+    __asm__({},[],[["obj", obj], ["props", props]],[],
+        "js::definePropertiesFromObject(%[%frame], %[obj].raw.oval, %[props]);"
+    );
 
     return obj;
 }
 
 function hidden (obj, prop, func)
 {
-    defineProperty(obj, prop, {writable: true, configurable: true, value: func});
+    needObject(obj, "hidden()");
+
+    __asm__({},[],[["obj", obj], ["prop", String(prop)], ["func", func]],[],
+        "%[obj].raw.oval->defineOwnPropertyExplicitThrowing(%[%frame], %[prop].raw.sval,"+
+        "    js::PROP_HAVE_CONFIGURABLE | js::PROP_CONFIGURABLE |"+
+        "    js::PROP_HAVE_WRITABLE | js::PROP_WRITEABLE |"+
+        "    js::PROP_HAVE_VALUE,"+
+        "  %[func]"+
+        ");"
+    );
 }
 
 function getter (obj, prop, func)
 {
-    defineProperty(obj, prop, {configurable: true, get: func});
+    accessor(obj, prop, func, void 0);
 }
 function accessor (obj, prop, getF, setF)
 {
-    defineProperty(obj, prop, {configurable: true, get: getF, set: setF});
+    needObject(obj, "accessor()");
+    if (typeof getF !== "function" || setF !== void 0 && typeof setF !== "function")
+        throw new TypeError("accessor() with a non-function");
+
+    __asm__({},[],[
+            ["obj", obj], ["prop", String(prop)],
+            ["get", getF], ["set", setF]
+        ],[["accessor"]],
+        "%[accessor] = js::makePropertyAccessorValue(new(%[%frame]) js::PropertyAccessor("+
+            "js::isFunction(%[get]),"+
+            "js::isFunction(%[set])"+
+        "));\n"+
+        "%[obj].raw.oval->defineOwnPropertyExplicitThrowing(%[%frame], %[prop].raw.sval,"+
+        "    js::PROP_HAVE_CONFIGURABLE | js::PROP_CONFIGURABLE | js::PROP_GET_SET,"+
+        "  %[accessor]"+
+        ");"
+    );
 }
 
 function constProp (obj, prop, value)
 {
-    defineProperty(obj, prop, {value: value, writable: false});
+    needObject(obj, "constProp()");
+
+    __asm__({},[],[["obj", obj], ["prop", String(prop)], ["value", value]],[],
+        "%[obj].raw.oval->defineOwnPropertyExplicitThrowing(%[%frame], %[prop].raw.sval,"+
+        "    js::PROP_HAVE_WRITABLE | js::PROP_HAVE_VALUE,"+
+        "  %[value]"+
+        ");"
+    );
 }
 
 function sealPrototype (obj, value)
@@ -289,6 +281,9 @@ defineProperty($jsc, "ICLS_Int32Array"       , {value: ICLS_Int32Array});
 defineProperty($jsc, "ICLS_Uint32Array"      , {value: ICLS_Uint32Array});
 defineProperty($jsc, "ICLS_Float32Array"     , {value: ICLS_Float32Array});
 defineProperty($jsc, "ICLS_Float64Array"     , {value: ICLS_Float64Array});
+defineProperty($jsc, "ICLS_Map"              , {value: ICLS_Map});
+defineProperty($jsc, "ICLS_Set"              , {value: ICLS_Set});
+defineProperty($jsc, "ICLS_CollectionIterator", {value: ICLS_CollectionIterator});
 
 constProp($jsc, "newInitTag", newInitTag);
 constProp($jsc, "setInitTag", setInitTag);
@@ -396,6 +391,8 @@ hidden(Object.prototype, "toString", function object_toString()
         case 24: return "[object Uint32Array]";  // ICLS_Uint32Array
         case 25: return "[object Float32Array]"; // ICLS_Float32Array
         case 26: return "[object Float64Array]"; // ICLS_Float64Array
+        case 27: return "[object Map]";          // ICLS_Map
+        case 28: return "[object Set]";          // ICLS_Set
     }
 });
 
@@ -492,24 +489,6 @@ hidden(URIError.prototype, "name", "URIError");
 
 // Array
 //
-function isArrayBase (arg)
-{
-    switch (getInternalClass(arg)) {
-        case 5: // ICLS_ARGUMENTS
-        case 6: // ICLS_ARRAY
-            return true;
-        default:
-            return false;
-    }
-}
-function isArrayBaseOfLength (arg, length)
-{
-    if (isArrayBase(arg))
-        return __asm__({},["result"],[["arg", arg], ["length", Number(length)]],[],
-            "js::ArrayBase * ab = static_cast<js::ArrayBase*>(%[arg].raw.oval);\n"+
-            "%[result] = js::makeBooleanValue(ab->getLength() >= %[length].raw.nval);"
-        );
-}
 function isArray (arg)
 {
     return getInternalClass(arg) === ICLS_ARRAY;
@@ -517,299 +496,6 @@ function isArray (arg)
 
 hidden(Array, "isArray", isArray);
 
-hidden(Array.prototype, "forEach", function array_forEach(callbackFn, thisArg)
-{
-    var O = toObject(this);
-    var len = O.length >>> 0; // toUint32
-    if (thisArg === undefined) {
-        for ( var k = 0; k < len; ++k )
-            if (k in O)
-                callbackFn(O[k], k, O);
-    } else {
-        for ( var k = 0; k < len; ++k )
-            if (k in O)
-                callbackFn.call(thisArg, O[k], k, O);
-    }
-});
-
-hidden(Array.prototype, "push", function array_push(dummy)
-{
-    var O = toObject(this);
-    var n = O.length >>> 0;
-    /*
-        This is what the code does, but we want to avoid allocating the arguments object
-
-        var argc = arguments.length >>> 0;
-        O.length = n + argc; // Resize the array in advance
-        for ( var i = 0; i < argc; ++i )
-            O[n++] = arguments[i];
-     */
-    var argc = __asm__({},["result"],[],[],"%[result] = js::makeNumberValue(%[%argc]);");
-    O.length = n + argc - 1;
-    for ( var i = 1; i < argc; ++i )
-        O[n++] = __asm__({},["result"],[["i",i]],[],"%[result] = %[%argv][(uint32_t)%[i].raw.nval]");
-    return n;
-});
-
-hidden(Array.prototype, "pop", function array_pop()
-{
-    var O = toObject(this);
-    var len = O.length >>> 0;
-    if (len !== 0) {
-        --len;
-        var element = O[len];
-        delete O[len];
-        O.length = len;
-        return element;
-    } else {
-        O.length = 0;
-        return void 0;
-    }
-});
-
-/**
- * Copy from an array-like object to an instance of ArrayBase. src and dest could be the same (copying values
- * within the same array).
- *
- * @param dest - must be ArrayBase of sufficient length and it must be filled with "holes" (unless it is the same as src)
- * @param destIndex - must be a number
- * @param src
- * @param srcFrom - must be a number
- * @param srcTo - must be a number
- */
-function copyToArray (dest, destIndex, src, srcFrom, srcTo)
-{
-    if (isArrayBaseOfLength(src, srcTo)) {
-        // Fast case - copying from array to array
-        // We know that dest is an array of sufficient size, destIndex, srcFrom and srcTo are numbers.
-
-        __asm__({},[],[["dest",dest], ["destIndex",destIndex], ["src",src], ["srcFrom",srcFrom], ["srcTo",srcTo]],[],
-            "uint32_t srcFrom = (uint32_t)%[srcFrom].raw.nval;\n"+
-            "uint32_t srcTo = (uint32_t)%[srcTo].raw.nval;\n"+
-            "::memmove("+
-                "&((js::ArrayBase *)%[dest].raw.oval)->elems[(uint32_t)%[destIndex].raw.nval],"+
-                "&((js::ArrayBase *)%[src].raw.oval)->elems[srcFrom],"+
-                "sizeof(js::TaggedValue)*(srcTo - srcFrom)"+
-            ");"
-        );
-    } else {
-        for ( var i = srcFrom; i < srcTo; ++i, ++destIndex )
-            if (i in src)
-                dest[destIndex] = src[i];
-    }
-}
-
-hidden(Array.prototype, "concat", function array_concat()
-{
-    var O = toObject(this);
-    var n;
-
-    // Size the result array first
-    n = isArray(O) ? Number(O.length) : 1;
-    for ( var i = 0, e = arguments.length; i < e; ++i ) {
-        var elem = arguments[i];
-        n += isArray(elem) ? Number(elem.length) : 1;
-    }
-
-    var A = [];
-    A.length = n;
-
-    n = 0;
-    // Copy O
-    if (isArray(O)) {
-        var len = Number(O.length);
-        copyToArray(A, n, O, 0, len);
-        n += len;
-    } else {
-        A[n++] = O;
-    }
-
-    for ( var i = 0, e = arguments.length; i < e; ++i ) {
-        var elem = arguments[i];
-        if (isArray(elem)) {
-            var len = Number(elem.length);
-            copyToArray(A, n, elem, 0, len);
-            n += len;
-        } else {
-            A[n++] = elem;
-        }
-    }
-
-    return A;
-});
-
-hidden(Array.prototype, "slice", function array_slice(start, end)
-{
-    var O = toObject(this);
-    var A = [];
-    var len = O.length >>> 0; // toUint32()
-    var k, final;
-
-    if ((k = Number(start)) < 0) {
-        if ((k += len) < 0)
-            k = 0;
-    } else {
-        if (k > len)
-            k = len;
-    }
-
-    if (end !== void 0) {
-        if ((final = Number(end)) < 0) {
-            if ((final += len) < 0)
-                final = 0;
-        } else {
-            if (final > len)
-                final = len;
-        }
-    } else {
-        final = len;
-    }
-
-    k >>>= 0; // toUint32
-    final >>>= 0; // toUint32
-
-    A.length = final - k;
-    copyToArray(A, 0, O, k, final);
-
-    return A;
-});
-
-hidden(Array.prototype, "join", function array_join (sep)
-{
-    var O = toObject(this);
-    var len = O.length >>> 0; // toUint32()
-    if (!len)
-        return "";
-
-    sep = (sep === void 0) ? "," : String(sep);
-
-    var R, elem;
-
-    elem = O[0];
-    R = elem === void 0 || elem === null ? "" : String(elem);
-    for ( var k = 1; k < len; ++k ) {
-        elem = O[k];
-        R += sep + (elem === void 0 || elem === null ? "" : String(elem));
-    }
-    return R;
-});
-
-hidden(Array.prototype, "splice", function array_splice(start, deleteCount)
-{
-    var O = toObject(this);
-
-    var len = O.length >>> 0;
-    var actualStart;
-
-    if ((actualStart = Number(start)) < 0) {
-        if ((actualStart += len) < 0)
-            actualStart = 0;
-    } else {
-        if (actualStart > len)
-            actualStart = len;
-    }
-    actualStart >>>= 0; // toUint32
-
-    var actualDeleteCount;
-    if ((actualDeleteCount = Number(deleteCount)) < 0) {
-        actualDeleteCount = 0;
-    } else {
-        var tmp = len - actualStart;
-        if (actualDeleteCount > tmp)
-            actualDeleteCount = tmp;
-    }
-    actualDeleteCount >>>= 0; // toUint32
-
-    var A = [];
-    A.length = actualDeleteCount;
-
-    if (actualDeleteCount > 0)
-        copyToArray(A, 0, O, actualStart, actualStart + actualDeleteCount);
-
-    var itemCount = __asm__({},["res"],[],[],"%[res] = js::makeNumberValue(%[%argc] - 3);");
-    if (itemCount < 0)
-        itemCount = 0;
-
-    if (itemCount > actualDeleteCount)
-        O.length += itemCount - actualDeleteCount;
-
-    if (itemCount !== actualDeleteCount) {
-        // Shift the rest of the array (actualDeleteCount - itemCount) to the left
-        if (isArrayBase(O)) {
-            copyToArray(O, actualStart + itemCount, O, actualStart + actualDeleteCount, len);
-        } else {
-            var destIndex = actualStart + itemCount;
-            var srcFrom = actualStart + actualDeleteCount;
-
-            if (destIndex <= srcFrom) {
-                for ( var i = srcFrom; i < len; ++i, ++destIndex ) {
-                    if (i in O)
-                        O[destIndex] = O[i];
-                    else
-                        delete O[destIndex];
-                }
-
-                for ( ; destIndex < len; ++destIndex )
-                    delete O[destIndex];
-            } else {
-                // Copy in reverse direction
-                destIndex += (len - srcFrom);
-                for ( var i = len; i > srcFrom; ) {
-                    --i;
-                    --destIndex;
-                    if (i in O)
-                        O[destIndex] = O[i];
-                    else
-                        delete O[destIndex];
-                }
-            }
-        }
-    }
-
-    if (itemCount < actualDeleteCount)
-        O.length += itemCount - actualDeleteCount;
-
-
-    // copy the new items
-    for ( var i = 0; i < itemCount; ++i ) {
-        O[actualStart++] = __asm__({},["res"],[["i",i]],[],
-            "%[res] = %[%argv][(unsigned)%[i].raw.nval + 3];"
-        );
-    }
-
-    return A;
-});
-
-hidden(Array.prototype, "shift", function array_shift()
-{
-    var O = toObject(this);
-
-    var len = O.length >>> 0;
-
-    if (len === 0) {
-        O.length = 0;
-        return undefined;
-    }
-
-    var res = O[0];
-
-    if (isArrayBase(O)) {
-        copyToArray(O, 0, O, 1, len);
-    } else {
-        for ( var i = 1; i < len; ++i ) {
-            if (i in O)
-                O[i-1] = O[i];
-            else
-                delete O[i-1];
-        }
-
-        delete O[len-1];
-    }
-
-    O.length = len - 1;
-    return res;
-});
-
 hidden(Array.prototype, "toString", function array_toString()
 {
     var array = toObject(this);
@@ -866,11 +552,11 @@ hidden(String.prototype, "indexOf", function string_indexOf (searchString, posit
         "bool secondSurr;\n" +
         "const unsigned char * startPos = haystack->charPos((uint32_t)%[start].raw.nval, &secondSurr);\n" +
         "const unsigned char * pos = (const unsigned char *)jsmemmem(" +
-            "startPos, haystack->_str + haystack->byteLength - startPos, " +
-            "%[searchStr].raw.sval->_str, %[searchStr].raw.sval->byteLength" +
+            "startPos, haystack->chars() + haystack->byteLength - startPos, " +
+            "%[searchStr].raw.sval->chars(), %[searchStr].raw.sval->byteLength" +
         ");\n" +
         "if (pos)\n" +
-        "  %[result] = js::makeNumberValue(haystack->byteOffsetToUTF16Index(pos - haystack->_str));\n" +
+        "  %[result] = js::makeNumberValue(haystack->byteOffsetToUTF16Index(pos - haystack->chars()));\n" +
         "else\n" +
         "  %[result] = js::makeNumberValue(-1);"
     );
@@ -897,11 +583,11 @@ hidden(String.prototype, "lastIndexOf", function string_indexOf (searchString, p
         "const js::StringPrim * haystack = %[S].raw.sval;\n" +
         "bool secondSurr;\n" +
         "const unsigned char * pos = (const unsigned char *)js::memrmem(" +
-            "haystack->_str, (size_t)%[end].raw.nval, " +
-            "%[searchStr].raw.sval->_str, %[searchStr].raw.sval->byteLength" +
+            "haystack->chars(), (size_t)%[end].raw.nval, " +
+            "%[searchStr].raw.sval->chars(), %[searchStr].raw.sval->byteLength" +
         ");\n" +
         "if (pos)\n" +
-        "  %[result] = js::makeNumberValue(haystack->byteOffsetToUTF16Index(pos - haystack->_str));\n" +
+        "  %[result] = js::makeNumberValue(haystack->byteOffsetToUTF16Index(pos - haystack->chars()));\n" +
         "else\n" +
         "  %[result] = js::makeNumberValue(-1);"
     );
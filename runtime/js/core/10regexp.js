@@ -86,7 +86,7 @@ var $RegExp = RegExp = function RegExp (pattern, flags)
         "pcre2_code * re;\n" +
         "int errorCode;\n" +
         "PCRE2_SIZE errorOffset;\n" +
-        "re = pcre2_compile(%[pattern].raw.sval->_str, %[pattern].raw.sval->byteLength, " +
+        "re = pcre2_compile(%[pattern].raw.sval->chars(), %[pattern].raw.sval->byteLength, " +
         "PCRE2_ALT_BSUX | PCRE2_NEVER_BACKSLASH_C | PCRE2_NEVER_UCP | PCRE2_NO_UTF_CHECK | PCRE2_UTF | " +
             "(unsigned)(%[nflags].raw.nval), " +
         "&errorCode, &errorOffset, NULL" +
@@ -183,9 +183,9 @@ function domatch (obj, str)
         "if (%[startIndex].raw.nval) {\n" +
         "  bool secondSurrogate;" +
         "  const unsigned char * p = %[str].raw.sval->charPos((uint32_t)%[startIndex].raw.nval, &secondSurrogate);\n" +
-        "  startoffset = p - %[str].raw.sval->_str;\n" +
+        "  startoffset = p - %[str].raw.sval->chars();\n" +
         "}\n" +
-        "int rc = pcre2_match(re, %[str].raw.sval->_str, %[str].raw.sval->byteLength," +
+        "int rc = pcre2_match(re, %[str].raw.sval->chars(), %[str].raw.sval->byteLength," +
         "  startoffset," +
         "  PCRE2_NO_UTF_CHECK," +
         "  match, NULL" +
@@ -49,7 +49,7 @@ function decodeURI (encodedURI)
     __asmh__({}, '#include "jsc/uri.h"');
     var res = __asm__({},["res"],[["uriString", uriString]],[],
         "const js::StringPrim * s = %[uriString].raw.sval;\n" +
-        "const js::StringPrim * res = js::uriDecode(%[%frame], s->_str, s->_str + s->byteLength, &js::uriDecodeSet);\n" +
+        "const js::StringPrim * res = js::uriDecode(%[%frame], s->chars(), s->chars() + s->byteLength, &js::uriDecodeSet);\n" +
         "%[res] = res ? js::makeStringValue(res) : JS_NULL_VALUE;"
     );
     if (res === null)
@@ -64,7 +64,7 @@ function decodeURIComponent (encodedURI)
     __asmh__({}, '#include "jsc/uri.h"');
     var res = __asm__({},["res"],[["uriString", uriString]],[],
         "const js::StringPrim * s = %[uriString].raw.sval;\n" +
-        "const js::StringPrim * res = js::uriDecode(%[%frame], s->_str, s->_str + s->byteLength, &js::uriEmptySet);\n" +
+        "const js::StringPrim * res = js::uriDecode(%[%frame], s->chars(), s->chars() + s->byteLength, &js::uriEmptySet);\n" +
         "%[res] = res ? js::makeStringValue(res) : JS_NULL_VALUE;"
     );
     if (res === null)
@@ -79,7 +79,7 @@ function encodeURI (uri)
     __asmh__({}, '#include "jsc/uri.h"');
     var res = __asm__({},["res"],[["uriString", uriString]],[],
         "const js::StringPrim * s = %[uriString].raw.sval;\n" +
-        "const js::StringPrim * res = js::uriEncode(%[%frame], s->_str, s->_str + s->byteLength, &js::uriEncodeSet);\n" +
+        "const js::StringPrim * res = js::uriEncode(%[%frame], s->chars(), s->chars() + s->byteLength, &js::uriEncodeSet);\n" +
         "%[res] = res ? js::makeStringValue(res) : JS_NULL_VALUE;"
     );
     if (res === null)
@@ -94,7 +94,7 @@ function encodeURIComponent (uri)
     __asmh__({}, '#include "jsc/uri.h"');
     var res = __asm__({},["res"],[["uriString", uriString]],[],
         "const js::StringPrim * s = %[uriString].raw.sval;\n" +
-        "const js::StringPrim * res = js::uriEncode(%[%frame], s->_str, s->_str + s->byteLength, &js::uriEncodeComponentSet);\n" +
+        "const js::StringPrim * res = js::uriEncode(%[%frame], s->chars(), s->chars() + s->byteLength, &js::uriEncodeComponentSet);\n" +
         "%[res] = res ? js::makeStringValue(res) : JS_NULL_VALUE;"
     );
     if (res === null)
@@ -0,0 +1,512 @@
+// Copyright (c) 2015 Tzvetan Mikov and contributors (see AUTHORS).
+// Licensed under the Apache License v2.0. See LICENSE in the project
+// root for complete license information.
+
+#include "jsc/collections.h"
+#include "jsc/jsimpl.h"
+
+#include <algorithm>
+
+namespace js {
+
+static inline uint32_t mixHash (uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (uint32_t)h;
+}
+
+static uint32_t hashValue (TaggedValue v)
+{
+    switch (v.tag) {
+        case VT_NUMBER:
+            // NaN-s are canonical, but -0 must hash like +0
+            return v.raw.nval == 0 ? mixHash(makeNumberValue(0).bits) : mixHash(v.bits);
+        case VT_STRINGPRIM:
+            return v.raw.sval->hash();
+        default:
+            return mixHash(v.bits);
+    }
+}
+
+static inline bool sameValueZero (TaggedValue a, TaggedValue b)
+{
+    // NaN-s are canonical, so they have the same bits
+    return a.bits == b.bits || operator_IF_STRICT_EQ(a, b);
+}
+
+uint32_t * OrderedHashTable::findSlot (TaggedValue key, uint32_t hash)
+{
+    if (this->index.empty())
+        return NULL;
+    // The index always has empty slots, so the loop terminates
+    for ( uint32_t i = hash & this->mask; ; i = (i + 1) & this->mask ) {
+        uint32_t e = this->index[i];
+        if (e == EMPTY)
+            return NULL;
+        if (e != DELETED && sameValueZero(this->entries[e].key, key))
+            return &this->index[i];
+    }
+}
+
+TaggedValue * OrderedHashTable::find (TaggedValue key)
+{
+    if (uint32_t * slot = findSlot(key, hashValue(key)))
+        return &this->entries[*slot].value;
+    return NULL;
+}
+
+void OrderedHashTable::set (TaggedValue key, TaggedValue value, std::vector<CollectionIterator *> & iterators)
+{
+    if (key.tag == VT_NUMBER && key.raw.nval == 0)
+        key.raw.nval = 0; // -0 becomes +0
+
+    uint32_t hash = hashValue(key);
+    if (uint32_t * slot = findSlot(key, hash)) {
+        this->entries[*slot].value = value;
+        return;
+    }
+
+    // Every entry has used up a slot since the last rebuild, even if it has been deleted since
+    if ((this->entries.size() + 1) * 4 > this->index.size() * 3)
+        rebuild(iterators);
+
+    uint32_t i = hash & this->mask;
+    while (this->index[i] != EMPTY && this->index[i] != DELETED)
+        i = (i + 1) & this->mask;
+    this->index[i] = (uint32_t)this->entries.size();
+    this->entries.push_back(Entry{key, value});
+    ++this->count;
+}
+
+bool OrderedHashTable::erase (TaggedValue key)
+{
+    if (uint32_t * slot = findSlot(key, hashValue(key))) {
+        Entry & e = this->entries[*slot];
+        e.key = JS_ARRAY_HOLE_VALUE;
+        e.value = JS_UNDEFINED_VALUE;
+        *slot = DELETED;
+        --this->count;
+        return true;
+    }
+    return false;
+}
+
+void OrderedHashTable::clear (std::vector<CollectionIterator *> & iterators)
+{
+    this->entries.clear();
+    this->index.clear();
+    this->mask = 0;
+    this->count = 0;
+    for ( CollectionIterator * it : iterators )
+        it->pos = 0;
+}
+
+void OrderedHashTable::rebuild (std::vector<CollectionIterator *> & iterators)
+{
+    uint32_t capacity = MIN_CAPACITY;
+    while (capacity < (this->count + 1) * 2)
+        capacity <<= 1;
+
+    // Squeeze out the deleted entries
+    if (this->count != this->entries.size()) {
+        if (!iterators.empty()) {
+            // The new position of an iterator is the number of live entries before it
+            std::vector<uint32_t> livePos(this->entries.size() + 1);
+            uint32_t n = 0;
+            for ( size_t i = 0, e = this->entries.size(); i != e; ++i ) {
+                livePos[i] = n;
+                if (this->entries[i].key.tag != VT_ARRAY_HOLE)
+                    ++n;
+            }
+            livePos[this->entries.size()] = n;
+            for ( CollectionIterator * it : iterators )
+                it->pos = livePos[it->pos];
+        }
+
+        size_t to = 0;
+        for ( size_t i = 0, e = this->entries.size(); i != e; ++i )
+            if (this->entries[i].key.tag != VT_ARRAY_HOLE)
+                this->entries[to++] = this->entries[i];
+        this->entries.resize(to);
+    }
+
+    this->index.assign(capacity, EMPTY);
+    this->mask = capacity - 1;
+    for ( uint32_t n = 0, e = (uint32_t)this->entries.size(); n != e; ++n ) {
+        uint32_t i = hashValue(this->entries[n].key) & this->mask;
+        while (this->index[i] != EMPTY)
+            i = (i + 1) & this->mask;
+        this->index[i] = n;
+    }
+}
+
+bool OrderedHashTable::mark (IMark * marker, unsigned markBit) const
+{
+    for ( const Entry & e : this->entries )
+        if (!markValue(marker, markBit, e.key) || !markValue(marker, markBit, e.value))
+            return false;
+    return true;
+}
+
+Collection::~Collection ()
+{
+    // The iterators are being freed too, since they refer to us
+    for ( CollectionIterator * it : this->iterators )
+        it->coll = NULL;
+}
+
+bool Collection::mark (IMark * marker, unsigned markBit) const
+{
+    return super::mark(marker, markBit) && this->table.mark(marker, markBit);
+}
+
+CollectionIterator::~CollectionIterator ()
+{
+    detach();
+}
+
+bool CollectionIterator::mark (IMark * marker, unsigned markBit) const
+{
+    return super::mark(marker, markBit) && markMemory(marker, markBit, this->coll);
+}
+
+void CollectionIterator::attach (Collection * coll, Kind kind)
+{
+    assert(!this->coll);
+    this->coll = coll;
+    this->pos = 0;
+    this->kind = kind;
+    coll->iterators.push_back(this);
+}
+
+void CollectionIterator::detach ()
+{
+    if (Collection * coll = this->coll) {
+        auto it = std::find(coll->iterators.begin(), coll->iterators.end(), this);
+        assert(it != coll->iterators.end());
+        *it = coll->iterators.back();
+        coll->iterators.pop_back();
+        this->coll = NULL;
+    }
+}
+
+const OrderedHashTable::Entry * CollectionIterator::next ()
+{
+    if (!this->coll)
+        return NULL;
+    const std::vector<OrderedHashTable::Entry> & entries = this->coll->table.entries;
+    while (this->pos < entries.size()) {
+        const OrderedHashTable::Entry * e = &entries[this->pos++];
+        if (e->key.tag != VT_ARRAY_HOLE)
+            return e;
+    }
+    detach();
+    return NULL;
+}
+
+static Collection * thisCollection (StackFrame * caller, TaggedValue thisp, InternalClass icls, const char * method)
+{
+    if (!isValueTagObject(thisp.tag) || thisp.raw.oval->getInternalClass() != icls)
+        throwTypeError(caller, "%s called on incompatible receiver", method);
+    return static_cast<Collection *>(thisp.raw.oval);
+}
+
+static TaggedValue makePair (StackFrame * caller, TaggedValue a, TaggedValue b)
+{
+    StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":makePair", __LINE__);
+    Array * array = newInit<Array>(&frame, &frame.locals[0], JS_GET_RUNTIME(&frame)->arrayPrototype);
+    array->elems.push_back(a);
+    array->elems.push_back(b);
+    return frame.locals[0];
+}
+
+/**
+ * Add an item produced by the iterable passed to the constructor
+ */
+static void addItem (StackFrame * caller, Collection * coll, TaggedValue item)
+{
+    if (coll->getInternalClass() == ICLS_Set) {
+        coll->set(item, JS_UNDEFINED_VALUE);
+        return;
+    }
+
+    if (!isValueTagObject(item.tag))
+        throwTypeError(caller, "Map entry is not an object");
+    StackFrameN<0,2,0> frame(caller, NULL, __FILE__ ":addItem", __LINE__);
+    frame.locals[0] = item.raw.oval->getComputed(&frame, makeNumberValue(0));
+    frame.locals[1] = item.raw.oval->getComputed(&frame, makeNumberValue(1));
+    coll->set(frame.locals[0], frame.locals[1]);
+}
+
+static void initFromIterable (StackFrame * caller, Collection * coll, TaggedValue iterable)
+{
+    if (iterable.tag == VT_UNDEFINED || iterable.tag == VT_NULL)
+        return;
+
+    StackFrameN<0,3,0> frame(caller, NULL, __FILE__ ":initFromIterable", __LINE__);
+    frame.locals[0] = JS_LIKELY(isValueTagObject(iterable.tag)) ?
+        iterable : makeObjectValue(toObject(&frame, iterable));
+    Object * src = frame.locals[0].raw.oval;
+    InternalClass srcIcls = src->getInternalClass();
+
+    if (srcIcls == ICLS_Map || srcIcls == ICLS_Set) {
+        // Iterate the source directly, which sees the entries added by the callbacks, like an iterator would
+        CollectionIterator * it = newInit<CollectionIterator>(&frame, &frame.locals[1], NULL);
+        it->attach(static_cast<Collection *>(src), CollectionIterator::ENTRIES);
+        bool pairs = srcIcls == ICLS_Map;
+        while (const OrderedHashTable::Entry * e = it->next()) {
+            if (!pairs)
+                addItem(&frame, coll, e->key);
+            else if (coll->getInternalClass() == ICLS_Map)
+                coll->set(e->key, e->value);
+            else {
+                frame.locals[2] = makePair(&frame, e->key, e->value);
+                addItem(&frame, coll, frame.locals[2]);
+            }
+        }
+        return;
+    }
+
+    // Treat everything else as an array-like
+    uint32_t length = toUint32(&frame, src->get(&frame, JS_GET_RUNTIME(&frame)->permStrLength));
+    for ( uint32_t i = 0; i < length; ++i ) {
+        frame.locals[2] = src->getComputed(&frame, makeNumberValue(i));
+        addItem(&frame, coll, frame.locals[2]);
+    }
+}
+
+TaggedValue Map::aConstructor (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    assert(isValueTagObject(argv[0].tag) && argv[0].raw.oval->getInternalClass() == ICLS_Map);
+    initFromIterable(caller, static_cast<Map *>(argv[0].raw.oval), argc > 1 ? argv[1] : JS_UNDEFINED_VALUE);
+    return JS_UNDEFINED_VALUE;
+}
+
+TaggedValue Map::aFunction (StackFrame * caller, Env *, unsigned, const TaggedValue *)
+{
+    throwTypeError(caller, "Map requires 'new'");
+}
+
+TaggedValue Set::aConstructor (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    assert(isValueTagObject(argv[0].tag) && argv[0].raw.oval->getInternalClass() == ICLS_Set);
+    initFromIterable(caller, static_cast<Set *>(argv[0].raw.oval), argc > 1 ? argv[1] : JS_UNDEFINED_VALUE);
+    return JS_UNDEFINED_VALUE;
+}
+
+TaggedValue Set::aFunction (StackFrame * caller, Env *, unsigned, const TaggedValue *)
+{
+    throwTypeError(caller, "Set requires 'new'");
+}
+
+#define ARG(n)  (argc > (n) ? argv[n] : JS_UNDEFINED_VALUE)
+
+static TaggedValue mapGet (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    Collection * coll = thisCollection(caller, argv[0], ICLS_Map, "Map.prototype.get");
+    TaggedValue * pv = coll->table.find(ARG(1));
+    return pv ? *pv : JS_UNDEFINED_VALUE;
+}
+
+static TaggedValue mapSet (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    thisCollection(caller, argv[0], ICLS_Map, "Map.prototype.set")->set(ARG(1), ARG(2));
+    return argv[0];
+}
+
+static TaggedValue mapHas (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    return makeBooleanValue(thisCollection(caller, argv[0], ICLS_Map, "Map.prototype.has")->table.find(ARG(1)) != NULL);
+}
+
+static TaggedValue mapDelete (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    return makeBooleanValue(thisCollection(caller, argv[0], ICLS_Map, "Map.prototype.delete")->table.erase(ARG(1)));
+}
+
+static TaggedValue mapClear (StackFrame * caller, Env *, unsigned, const TaggedValue * argv)
+{
+    thisCollection(caller, argv[0], ICLS_Map, "Map.prototype.clear")->clear();
+    return JS_UNDEFINED_VALUE;
+}
+
+static TaggedValue mapSize (StackFrame * caller, Env *, unsigned, const TaggedValue * argv)
+{
+    return makeNumberValue(thisCollection(caller, argv[0], ICLS_Map, "Map.prototype.size")->table.count);
+}
+
+static TaggedValue setAdd (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    thisCollection(caller, argv[0], ICLS_Set, "Set.prototype.add")->set(ARG(1), JS_UNDEFINED_VALUE);
+    return argv[0];
+}
+
+static TaggedValue setHas (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    return makeBooleanValue(thisCollection(caller, argv[0], ICLS_Set, "Set.prototype.has")->table.find(ARG(1)) != NULL);
+}
+
+static TaggedValue setDelete (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    return makeBooleanValue(thisCollection(caller, argv[0], ICLS_Set, "Set.prototype.delete")->table.erase(ARG(1)));
+}
+
+static TaggedValue setClear (StackFrame * caller, Env *, unsigned, const TaggedValue * argv)
+{
+    thisCollection(caller, argv[0], ICLS_Set, "Set.prototype.clear")->clear();
+    return JS_UNDEFINED_VALUE;
+}
+
+static TaggedValue setSize (StackFrame * caller, Env *, unsigned, const TaggedValue * argv)
+{
+    return makeNumberValue(thisCollection(caller, argv[0], ICLS_Set, "Set.prototype.size")->table.count);
+}
+
+static TaggedValue collectionForEach (
+    StackFrame * caller, unsigned argc, const TaggedValue * argv, InternalClass icls, const char * method
+)
+{
+    StackFrameN<0,6,0> frame(caller, NULL, __FILE__ ":collectionForEach", __LINE__);
+    Collection * coll = thisCollection(&frame, argv[0], icls, method);
+    Function * callback = isFunction(ARG(1));
+    if (!callback)
+        throwTypeError(&frame, "%s: callback is not a function", method);
+    frame.locals[0] = ARG(1);
+
+    CollectionIterator * it = newInit<CollectionIterator>(&frame, &frame.locals[1], NULL);
+    it->attach(coll, CollectionIterator::ENTRIES);
+
+    // thisArg, value, key, collection
+    frame.locals[2] = ARG(2);
+    frame.locals[5] = argv[0];
+    bool isSet = icls == ICLS_Set;
+    while (const OrderedHashTable::Entry * e = it->next()) {
+        frame.locals[3] = isSet ? e->key : e->value;
+        frame.locals[4] = e->key;
+        callback->call(&frame, 4, &frame.locals[2]);
+    }
+    return JS_UNDEFINED_VALUE;
+}
+
+static TaggedValue mapForEach (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    return collectionForEach(caller, argc, argv, ICLS_Map, "Map.prototype.forEach");
+}
+
+static TaggedValue setForEach (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    return collectionForEach(caller, argc, argv, ICLS_Set, "Set.prototype.forEach");
+}
+
+static TaggedValue makeIterator (
+    StackFrame * caller, TaggedValue thisp, InternalClass icls, CollectionIterator::Kind kind, const char * method
+)
+{
+    StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":makeIterator", __LINE__);
+    Collection * coll = thisCollection(&frame, thisp, icls, method);
+    CollectionIterator * it = newInit<CollectionIterator>(
+        &frame, &frame.locals[0], JS_GET_RUNTIME(&frame)->collectionIteratorPrototype
+    );
+    it->attach(coll, kind);
+    return frame.locals[0];
+}
+
+static TaggedValue mapKeys (StackFrame * caller, Env *, unsigned, const TaggedValue * argv)
+{
+    return makeIterator(caller, argv[0], ICLS_Map, CollectionIterator::KEYS, "Map.prototype.keys");
+}
+
+static TaggedValue mapValues (StackFrame * caller, Env *, unsigned, const TaggedValue * argv)
+{
+    return makeIterator(caller, argv[0], ICLS_Map, CollectionIterator::VALUES, "Map.prototype.values");
+}
+
+static TaggedValue mapEntries (StackFrame * caller, Env *, unsigned, const TaggedValue * argv)
+{
+    return makeIterator(caller, argv[0], ICLS_Map, CollectionIterator::ENTRIES, "Map.prototype.entries");
+}
+
+static TaggedValue setValues (StackFrame * caller, Env *, unsigned, const TaggedValue * argv)
+{
+    return makeIterator(caller, argv[0], ICLS_Set, CollectionIterator::KEYS, "Set.prototype.values");
+}
+
+static TaggedValue setEntries (StackFrame * caller, Env *, unsigned, const TaggedValue * argv)
+{
+    return makeIterator(caller, argv[0], ICLS_Set, CollectionIterator::ENTRIES, "Set.prototype.entries");
+}
+
+static TaggedValue iteratorNext (StackFrame * caller, Env *, unsigned, const TaggedValue * argv)
+{
+    StackFrameN<0,2,0> frame(caller, NULL, __FILE__ ":iteratorNext", __LINE__);
+    Runtime * r = JS_GET_RUNTIME(&frame);
+
+    if (!isValueTagObject(argv[0].tag) || argv[0].raw.oval->getInternalClass() != ICLS_CollectionIterator)
+        throwTypeError(&frame, "next() called on incompatible receiver");
+    CollectionIterator * it = static_cast<CollectionIterator *>(argv[0].raw.oval);
+
+    bool done;
+    if (const OrderedHashTable::Entry * e = it->next()) {
+        done = false;
+        switch (it->kind) {
+            case CollectionIterator::KEYS: frame.locals[0] = e->key; break;
+            case CollectionIterator::VALUES: frame.locals[0] = e->value; break;
+            case CollectionIterator::ENTRIES:
+                frame.locals[0] = it->coll->getInternalClass() == ICLS_Set ?
+                    makePair(&frame, e->key, e->key) : makePair(&frame, e->key, e->value);
+                break;
+        }
+    } else {
+        done = true;
+        frame.locals[0] = JS_UNDEFINED_VALUE;
+    }
+
+    Object * res = Object::make(&frame, r->objectPrototype, NULL);
+    frame.locals[1] = makeObjectValue(res);
+    res->addOwnProperty(&frame, r->permStrValue, PROP_NORMAL, frame.locals[0]);
+    res->addOwnProperty(&frame, r->permStrDone, PROP_NORMAL, makeBooleanValue(done));
+    return frame.locals[1];
+}
+
+static void defineGetter (StackFrame * caller, Object * obj, const char * sname, CodePtr code)
+{
+    StackFrameN<0,2,0> frame(caller, NULL, __FILE__ ":defineGetter", __LINE__);
+    Runtime * r = JS_GET_RUNTIME(&frame);
+    const StringPrim * name;
+    frame.locals[0] = makeStringValue(name = r->internString(&frame, true, sname));
+    frame.locals[1] = newFunction(&frame, NULL, name, 0, code);
+    frame.locals[1] = makePropertyAccessorValue(new(&frame) PropertyAccessor(frame.locals[1].raw.fval, NULL));
+    obj->defineOwnProperty(&frame, name, PROP_GET_SET | PROP_CONFIGURABLE, frame.locals[1]);
+}
+
+void collectionsInit (StackFrame * caller)
+{
+    Runtime * r = JS_GET_RUNTIME(caller);
+
+    r->defineMethod(caller, r->mapPrototype, "get", 1, mapGet);
+    r->defineMethod(caller, r->mapPrototype, "set", 2, mapSet);
+    r->defineMethod(caller, r->mapPrototype, "has", 1, mapHas);
+    r->defineMethod(caller, r->mapPrototype, "delete", 1, mapDelete);
+    r->defineMethod(caller, r->mapPrototype, "clear", 0, mapClear);
+    r->defineMethod(caller, r->mapPrototype, "forEach", 1, mapForEach);
+    r->defineMethod(caller, r->mapPrototype, "keys", 0, mapKeys);
+    r->defineMethod(caller, r->mapPrototype, "values", 0, mapValues);
+    r->defineMethod(caller, r->mapPrototype, "entries", 0, mapEntries);
+    defineGetter(caller, r->mapPrototype, "size", mapSize);
+
+    r->defineMethod(caller, r->setPrototype, "add", 1, setAdd);
+    r->defineMethod(caller, r->setPrototype, "has", 1, setHas);
+    r->defineMethod(caller, r->setPrototype, "delete", 1, setDelete);
+    r->defineMethod(caller, r->setPrototype, "clear", 0, setClear);
+    r->defineMethod(caller, r->setPrototype, "forEach", 1, setForEach);
+    r->defineMethod(caller, r->setPrototype, "keys", 0, setValues);
+    r->defineMethod(caller, r->setPrototype, "values", 0, setValues);
+    r->defineMethod(caller, r->setPrototype, "entries", 0, setEntries);
+    defineGetter(caller, r->setPrototype, "size", setSize);
+
+    r->defineMethod(caller, r->collectionIteratorPrototype, "next", 0, iteratorNext);
+}
+
+}; // namespace js
@@ -67,7 +67,7 @@ TaggedValue fsMakeReaddirArray (StackFrame * caller, uv_fs_t * req)
         uv_dirent_t ent;
         if (uv_fs_scandir_next(req, &ent) == UV_EOF)
             break;
-        ((Array *)frame.locals[0].raw.oval)->elems[i] = js::makeStringValueFromUnvalidated(&frame, ent.name);
+        ((Array *)frame.locals[0].raw.oval)->setElem(i, js::makeStringValueFromUnvalidated(&frame, ent.name));
     }
 
     if (i != count) // Not sure if this could happen, but just in case
@@ -52,6 +52,21 @@ void _release (Memory * m, Runtime * runtime)
     free(m);
 }
 
+void * allocateExternal (size_t size)
+{
+    void * p = malloc(size);
+    if (p)
+        g_runtime->allocatedSize += size;
+    return p;
+}
+
+void releaseExternal (void * p, size_t size)
+{
+    assert(g_runtime->allocatedSize >= size);
+    g_runtime->allocatedSize -= size;
+    free(p);
+}
+
 void forceGC (StackFrame * caller)
 {
     if (JS_GET_RUNTIME(caller)->diagFlags & Runtime::DIAG_HEAP_GC)
@@ -188,11 +203,18 @@ static void collect (StackFrame * caller)
         runtime->tail = lastMarked;
     }
 
+    // The property cache may refer to freed objects and properties
+    runtime->clearPropCache();
+    if (JS_UNLIKELY(++runtime->gcEpoch == 0))
+        runtime->gcEpoch = 1;
+
     runtime->gcThreshold = std::max(runtime->gcThreshold, runtime->allocatedSize * 2);
 
     if (runtime->diagFlags & Runtime::DIAG_HEAP_GC) {
         fprintf(
-            stderr, "Freed %zu bytes. Threshold=%zu Allocated=%zu\n", startAllocatedSize - runtime->allocatedSize,
+            // Copying slices during marking allocates, so this can be negative
+            stderr, "Freed %ld bytes. Threshold=%zu Allocated=%zu\n",
+            (long)startAllocatedSize - (long)runtime->allocatedSize,
             runtime->gcThreshold, runtime->allocatedSize
         );
 #ifdef JS_DEBUG
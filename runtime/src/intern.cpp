@@ -0,0 +1,153 @@
+// Copyright (c) 2015 Tzvetan Mikov and contributors (see AUTHORS).
+// Licensed under the Apache License v2.0. See LICENSE in the project
+// root for complete license information.
+
+#include "jsc/objects.h"
+
+namespace js {
+
+InternTable::InternTable () :
+    movePos(0),
+    oldCount(0),
+    count(0)
+{
+    cur.slots.resize(MIN_CAPACITY, NULL);
+}
+
+/**
+ * Find the slot of a string which is in the table
+ */
+const StringPrim ** InternTable::Table::findSlot (const StringPrim * str)
+{
+    uint32_t m = mask();
+    for ( uint32_t i = str->hash() & m;; i = (i + 1) & m ) {
+        const StringPrim ** slot = &slots[i];
+        if (*slot == str)
+            return slot;
+        if (*slot == NULL)
+            return NULL;
+    }
+}
+
+/**
+ * Add a string, which is known not to be in the table, in the first free or removed slot
+ */
+void InternTable::Table::add (const StringPrim * str)
+{
+    uint32_t m = mask();
+    for ( uint32_t i = str->hash() & m;; i = (i + 1) & m ) {
+        const StringPrim ** slot = &slots[i];
+        if (*slot == NULL) {
+            ++used;
+            *slot = str;
+            return;
+        }
+        if (*slot == removed()) {
+            *slot = str;
+            return;
+        }
+    }
+}
+
+const StringPrim * InternTable::find (const Table & t, const unsigned char * str, unsigned length, uint32_t hash)
+{
+    uint32_t m = t.mask();
+    for ( uint32_t i = hash & m;; i = (i + 1) & m ) {
+        const StringPrim * s = t.slots[i];
+        if (s == NULL)
+            return NULL;
+        // The strings in the table always have their hash computed
+        if (s != removed() && s->hashValue == hash && s->byteLength == length &&
+            memcmp(s->chars(), str, length) == 0)
+        {
+            return s;
+        }
+    }
+}
+
+const StringPrim * InternTable::find (const unsigned char * str, unsigned length, uint32_t hash) const
+{
+    if (const StringPrim * res = find(cur, str, length, hash))
+        return res;
+    if (JS_UNLIKELY(oldCount != 0))
+        return find(old, str, length, hash);
+    return NULL;
+}
+
+void InternTable::insert (const StringPrim * str)
+{
+    if (JS_UNLIKELY(oldCount != 0))
+        move(MOVE_STEP);
+
+    // Keep the load at most 1/2, counting the entries which are still to be moved
+    if (JS_UNLIKELY((cur.used + oldCount + 1) * 2 > cur.slots.size()))
+        grow();
+
+    cur.add(str);
+    ++count;
+}
+
+void InternTable::remove (const StringPrim * str)
+{
+    if (const StringPrim ** slot = cur.findSlot(str)) {
+        *slot = removed();
+    } else {
+        assert(oldCount != 0);
+        slot = old.findSlot(str);
+        assert(slot);
+        *slot = removed();
+        --oldCount;
+    }
+    --count;
+
+    if (JS_UNLIKELY(oldCount != 0))
+        move(MOVE_STEP);
+}
+
+/**
+ * Start moving the entries to a new table sized for the live entries. Removed slots are dropped in the
+ * process, so a table with many of them can end up the same size or even shrink.
+ */
+void InternTable::grow ()
+{
+    // Finish the previous move first. It is normally already done, because every operation moves more
+    // than one slot.
+    move(UINT32_MAX);
+
+    uint32_t capacity = MIN_CAPACITY;
+    while (capacity < count * 4)
+        capacity <<= 1;
+
+    std::swap(old, cur);
+    cur.slots.assign(capacity, NULL);
+    cur.used = 0;
+    movePos = 0;
+    oldCount = count;
+    if (!oldCount)
+        old = Table();
+}
+
+void InternTable::move (uint32_t slotCount)
+{
+    uint32_t end = (uint32_t)old.slots.size();
+    if (slotCount < end - movePos)
+        end = movePos + slotCount;
+
+    for ( ; movePos < end; ++movePos ) {
+        const StringPrim * s = old.slots[movePos];
+        if (s != NULL && s != removed()) {
+            cur.add(s);
+            // Clear the old copy: if the string is removed from 'cur', find() must not see it here
+            old.slots[movePos] = removed();
+            --oldCount;
+        }
+    }
+
+    if (oldCount == 0) {
+        // Free the old table
+        old = Table();
+        movePos = 0;
+    }
+}
+
+}; // namespace js
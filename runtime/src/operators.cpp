@@ -10,6 +10,10 @@ namespace js
 
 TaggedValue operator_ADD (StackFrame * caller, TaggedValue a, TaggedValue b)
 {
+    int32_t r;
+    if (JS_LIKELY(a.isInt32() && b.isInt32()) && !__builtin_add_overflow((int32_t)a.raw.ival, (int32_t)b.raw.ival, &r))
+        return makeInt32Value(r);
+
     // TODO: we can speed this up significantly by dispatching on the combination of types
     //switch ((a.tag << 2) + b.tag) {
 
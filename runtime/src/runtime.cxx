@@ -14,6 +14,7 @@
 #include <stdarg.h>
 #include <errno.h>
 #include <set>
+#include <algorithm>
 #include <tuple>
 #include <memory>
 
@@ -23,11 +24,6 @@ namespace js
 Runtime * g_runtime = NULL;
 StackFrame * g_topFrame = NULL;
 
-InternalClass Memory::getInternalClass () const
-{
-    return ICLS_MEMORY;
-}
-
 void Memory::finalizer ()
 { }
 
@@ -63,14 +59,86 @@ TaggedValue * Env::var (unsigned level, unsigned index)
     return &penv->vars[index];
 }
 
-InternalClass Object::getInternalClass () const
+void ObjectElements::add (uint32_t index, TaggedValue value)
+{
+    if (JS_LIKELY(!this->isSparse)) {
+        if (index < this->dense.size()) {
+            this->dense[index] = value;
+            ++this->count;
+            return;
+        }
+        if (index < MIN_DENSE_LENGTH || index < 2 * (this->count + 1)) {
+            this->dense.resize(index + 1, JS_ARRAY_HOLE_VALUE);
+            this->dense[index] = value;
+            ++this->count;
+            return;
+        }
+
+        // Too many holes: switch to the hash table
+        for ( uint32_t i = 0, e = (uint32_t)this->dense.size(); i < e; ++i )
+            if (this->dense[i].tag != VT_ARRAY_HOLE)
+                this->sparse.emplace(i, this->dense[i]);
+        std::vector<TaggedValue>().swap(this->dense);
+        this->isSparse = true;
+    }
+
+    this->sparse.emplace(index, value);
+    ++this->count;
+}
+
+void ObjectElements::erase (uint32_t index)
+{
+    if (JS_LIKELY(!this->isSparse)) {
+        this->dense[index].tag = VT_ARRAY_HOLE;
+        while (!this->dense.empty() && this->dense.back().tag == VT_ARRAY_HOLE)
+            this->dense.pop_back();
+    } else {
+        this->sparse.erase(index);
+    }
+    --this->count;
+}
+
+void ObjectElements::getIndexes (std::vector<uint32_t> & res) const
+{
+    size_t start = res.size();
+    if (JS_LIKELY(!this->isSparse)) {
+        for ( uint32_t i = 0, e = (uint32_t)this->dense.size(); i < e; ++i )
+            if (this->dense[i].tag != VT_ARRAY_HOLE)
+                res.push_back(i);
+    } else {
+        for ( const auto & e : this->sparse )
+            res.push_back(e.first);
+        std::sort(res.begin() + start, res.end());
+    }
+}
+
+bool ObjectElements::mark (IMark * marker, unsigned markBit) const
+{
+    for ( const auto & value : this->dense )
+        if (!markValue(marker, markBit, value))
+            return false;
+    for ( const auto & e : this->sparse )
+        if (!markValue(marker, markBit, e.second))
+            return false;
+    return true;
+}
+
+Object * Object::make (StackFrame * caller, Object * parent, AllocSite * site)
+{
+    unsigned slots = site ? site->slotCount : 0;
+    return new(caller, sizeof(Object) + sizeof(Property) * slots) Object(parent, site, slots);
+}
+
+Object::~Object ()
 {
-    return ICLS_OBJECT;
+    delete this->elements;
 }
 
-Object * Object::createDescendant (StackFrame * caller)
+Object * Object::createDescendant (StackFrame * caller, AllocSite * site)
 {
-    return newInit<Object>(caller, this);
+    // Lazy properties are created only when accessed directly, so they must exist before they can be inherited
+    ensureProps(caller);
+    return Object::make(caller, this, site);
 }
 
 ForInIterator * Object::makeIterator (StackFrame * caller)
@@ -84,14 +152,64 @@ ForInIterator * Object::makeIterator (StackFrame * caller)
 
 bool Object::mark (IMark * marker, unsigned markBit) const
 {
-    if (!markMemory(marker, markBit, parent))
+    if (!markMemory(marker, markBit, parent) || !markMemory(marker, markBit, enumCache))
         return false;
-    for (const auto & it : props)
-        if (!markMemory(marker, markBit, it.second.name) || !markValue(marker, markBit, it.second.value))
+    if (this->elements && !this->elements->mark(marker, markBit))
+        return false;
+    // Note that the list includes both the inline and the out-of-line properties
+    for ( const ListEntry * entry = this->propList.next; entry != &this->propList; entry = entry->next ) {
+        const Property * prop = static_cast<const Property *>(entry);
+        if (!markMemory(marker, markBit, prop->name) || !markValue(marker, markBit, prop->value))
             return false;
+    }
     return true;
 }
 
+Property * Object::addOwnProperty (StackFrame * caller, const StringPrim * name, unsigned flags, TaggedValue value)
+{
+    assert(name->isInterned());
+    ensureProps(caller);
+
+    Property * prop = NULL;
+    if (this->inlineUsed < this->inlineCapacity) {
+        prop = inlineSlots() + this->inlineUsed++;
+    } else {
+        // Look for a slot freed by a deletion
+        for ( Property * p = inlineSlots(), * e = p + this->inlineUsed; p != e; ++p )
+            if (!p->name) {
+                prop = p;
+                break;
+            }
+    }
+
+    if (prop) {
+        new(prop) Property(name, flags, value);
+    } else {
+#ifdef HAVE_CXX11_EMPLACE
+        prop = &props.emplace(
+            std::piecewise_construct, std::make_tuple(name->getStr()), std::make_tuple(name, flags, value)
+        ).first->second;
+#else
+        prop = &props.insert(
+            std::make_pair(name->getStr(), Property(name, flags, value))
+        ).first->second;
+#endif
+        // Tell the allocation site that its objects need more slots
+        if (AllocSite * site = this->allocSite) {
+            unsigned count = this->inlineCapacity + (unsigned)this->props.size();
+            if (count > site->slotCount && count <= MAX_INLINE_SLOTS)
+                site->slotCount = count;
+        }
+    }
+    this->propList.insertBefore(prop);
+    ++this->propVersion;
+
+    if (this->flags & OF_PROTOTYPE)
+        JS_GET_RUNTIME(caller)->invalidatePropCache();
+
+    return prop;
+}
+
 #define IS_DATA_DESCRIPTOR(flags)       (((flags) & (PROP_HAVE_VALUE | PROP_HAVE_WRITABLE)) != 0)
 #define IS_GENERIC_DESCRIPTOR(flags)    (!((flags) & (PROP_HAVE_VALUE | PROP_HAVE_WRITABLE | PROP_GET_SET)))
 
@@ -101,12 +219,24 @@ bool Object::defineOwnPropertyExplicit (StackFrame * caller, const StringPrim *
     assert(((flags & (PROP_GET_SET | PROP_HAVE_VALUE)) != (PROP_GET_SET | PROP_HAVE_VALUE)) &&
            "PROP_GET_SET and PROP_HAVE_VALUE specified at the same time");
 
+    ensureProps(caller);
     if (JS_UNLIKELY(!name->isInterned()))
         name = JS_GET_RUNTIME(caller)->internString(name);
 
+    uint32_t index;
+    if (JS_UNLIKELY(this->elements != NULL) && name->isIndex(&index)) {
+        if (TaggedValue * pv = this->elements->find(index)) {
+            // Properties with explicit attributes are kept by name, so convert the element first
+            TaggedValue elemValue = *pv;
+            this->elements->erase(index);
+            addOwnProperty(caller, name, PROP_NORMAL, elemValue);
+            this->flags |= OF_INDEX_PROPERTIES;
+        }
+    }
+
     // 1
-    auto it = props.find(name->getStr());
-    if (it == props.end()) {
+    Property * current = getOwnProperty(name);
+    if (!current) {
         // 3
         if (this->flags & OF_NOEXTEND)
             return false;
@@ -115,26 +245,16 @@ bool Object::defineOwnPropertyExplicit (StackFrame * caller, const StringPrim *
         flags &= PROP_FLAGS;
 
         // 4
-#ifdef HAVE_CXX11_EMPLACE
-        Property * prop = &props.emplace(
-            std::piecewise_construct, std::make_tuple(name->getStr()), std::make_tuple(name, flags, value)
-        ).first->second;
-#else
-        Property * prop = &props.insert(
-            std::make_pair(name->getStr(), Property(name, flags, value))
-        ).first->second;
-#endif
-        this->propList.insertBefore(prop);
+        addOwnProperty(caller, name, flags, value);
 
         // If index-like properties have been defined in this object, array accesses need to check them first
         uint32_t dummy;
-        if (isIndexString(name->getStr(), &dummy))
+        if (name->isIndex(&dummy))
             this->flags |= OF_INDEX_PROPERTIES;
 
         return true;
     }
 
-    Property * current = &it->second;
     unsigned currentFlags = current->flags;
 
     // 5
@@ -184,7 +304,7 @@ bool Object::defineOwnPropertyExplicit (StackFrame * caller, const StringPrim *
             // 11a
             // If the property is not configurable
             if ((this->flags & OF_NOCONFIG) || !(currentFlags & PROP_CONFIGURABLE)) {
-                assert(value.tag == VT_MEMORY && (!value.raw.mval || dynamic_cast<PropertyAccessor *>(value.raw.mval) != NULL));
+                assert(value.tag == VT_MEMORY && (!value.raw.mval || dynamic_cast<PropertyAccessor *>(value.raw.mval.get()) != NULL));
 
                 // We assume it could be null
                 if (PropertyAccessor * accessor = static_cast<PropertyAccessor *>(value.raw.mval)) {
@@ -218,6 +338,11 @@ bool Object::defineOwnPropertyExplicit (StackFrame * caller, const StringPrim *
         current->value = value;
     }
 
+    if ((current->flags ^ currentFlags) & PROP_ENUMERABLE) {
+        ++this->propVersion;
+        if (this->flags & OF_PROTOTYPE)
+            JS_GET_RUNTIME(caller)->invalidatePropCache();
+    }
     current->flags = currentFlags;
 
     return true;
@@ -246,18 +371,61 @@ void Object::defineOwnProperty (StackFrame * caller, const StringPrim * name, un
 
 Property * Object::getProperty (const StringPrim * name, Object ** propObj)
 {
-    Object * cur = this;
-    do {
-        if (Property * p = cur->getOwnProperty(name)) {
-            *propObj = cur;
-            return p;
-        }
-    } while ((cur = cur->parent) != NULL);
-    return NULL;
+    if (Property * p = getOwnProperty(name)) {
+        *propObj = this;
+        return p;
+    }
+    return this->parent ? getInheritedProperty(this->parent, name, propObj) : NULL;
+}
+
+Property * Object::getInheritedProperty (Object * start, const StringPrim * name, Object ** propObj)
+{
+    Object * cur = start;
+
+    // Only interned names have a stable identity which we can use as a key
+    if (JS_UNLIKELY(!name->isInterned())) {
+        do {
+            if (Property * p = cur->getOwnProperty(name)) {
+                *propObj = cur;
+                return p;
+            }
+        } while ((cur = cur->parent) != NULL);
+        return NULL;
+    }
+
+    Runtime * r = JS_GET_RUNTIME(NULL);
+    Runtime::PropCacheEntry * ce = &r->propCache[
+        (((uintptr_t)start >> 4) * 31 + ((uintptr_t)name >> 4)) & (Runtime::PROP_CACHE_SIZE - 1)
+    ];
+    if (JS_LIKELY(ce->start == start && ce->name == name && ce->epoch == r->protoEpoch)) {
+        *propObj = ce->holder;
+        return ce->prop;
+    }
+
+    // Note that 'start' could be an object which hasn't been used as a parent, like when we are accessing
+    // a property of a primitive value. From now on we must track its changes.
+    start->flags |= OF_PROTOTYPE;
+
+    Property * p;
+    do
+        if ((p = cur->getOwnProperty(name)) != NULL)
+            break;
+    while ((cur = cur->parent) != NULL);
+
+    ce->start = start;
+    ce->name = name;
+    ce->epoch = r->protoEpoch;
+    ce->holder = cur;
+    ce->prop = p;
+
+    *propObj = cur;
+    return p;
 }
 
 bool Object::hasProperty (const StringPrim * name)
 {
+    if (JS_UNLIKELY(this->flags & OF_LAZY_PROPS) && Function::isLazyPropName(name))
+        return true;
     Object * propObj;
     return getProperty(name, &propObj) != NULL;
 };
@@ -276,7 +444,7 @@ bool Object::updatePropertyValue (StackFrame * caller, Object * propObj, Propert
             }
         }
     } else {
-        if (Function * setter = ((PropertyAccessor *)p->value.raw.oval)->set) {
+        if (Function * setter = ((PropertyAccessor *)p->value.raw.mval)->set) {
             // Note: we don't need to create a frame for this because both parameters must be accessible
             // via different means
             if (true) {
@@ -299,6 +467,7 @@ bool Object::updatePropertyValue (StackFrame * caller, Object * propObj, Propert
 
 TaggedValue Object::get (StackFrame * caller, const StringPrim * name)
 {
+    ensureProps(caller);
     Object * propObj;
     if (Property * p = getProperty(name, &propObj))
         return getPropertyValue(caller, p);
@@ -307,6 +476,7 @@ TaggedValue Object::get (StackFrame * caller, const StringPrim * name)
 
 TaggedValue Object::getOwn (StackFrame * caller, const StringPrim * name)
 {
+    ensureProps(caller);
     if (Property * p = getOwnProperty(name))
         return getPropertyValue(caller, p);
     return JS_UNDEFINED_VALUE;
@@ -314,6 +484,7 @@ TaggedValue Object::getOwn (StackFrame * caller, const StringPrim * name)
 
 void Object::put (StackFrame * caller, const StringPrim * name, TaggedValue v)
 {
+    ensureProps(caller);
     if (JS_LIKELY(!(this->flags & OF_NOWRITE))) {
         Object * propObj;
         if (Property * p = getProperty(name, &propObj))
@@ -325,17 +496,7 @@ void Object::put (StackFrame * caller, const StringPrim * name, TaggedValue v)
             if (JS_UNLIKELY(!name->isInterned()))
                 name = JS_GET_RUNTIME(caller)->internString(name);
 
-#ifdef HAVE_CXX11_EMPLACE
-            Property * prop = &this->props.emplace(
-                std::piecewise_construct, std::make_tuple(name->getStr()),
-                std::make_tuple(name, PROP_WRITEABLE|PROP_ENUMERABLE|PROP_CONFIGURABLE, v)
-            ).first->second;
-#else
-            Property * prop = &this->props.insert(
-                std::make_pair(name->getStr(), Property(name, PROP_WRITEABLE|PROP_ENUMERABLE|PROP_CONFIGURABLE, v))
-            ).first->second;
-#endif
-            this->propList.insertBefore(prop);
+            addOwnProperty(caller, name, PROP_WRITEABLE|PROP_ENUMERABLE|PROP_CONFIGURABLE, v);
             return;
         }
     }
@@ -344,92 +505,338 @@ void Object::put (StackFrame * caller, const StringPrim * name, TaggedValue v)
         throwTypeError(caller, "Property '%s' is not writable", name->getStr());
 }
 
+int Object::findElement (uint32_t index, bool own, TaggedValue ** pv)
+{
+    Object * obj = this;
+    do {
+        if (JS_UNLIKELY((obj->flags & OF_INDEX_PROPERTIES) || obj->hasClassBits(CLS_INDEXED)))
+            return -1;
+        if (obj->elements && (*pv = obj->elements->find(index)) != NULL)
+            return 1;
+    } while (!own && (obj = obj->parent) != NULL);
+    return 0;
+}
+
+int Object::findIndexProperty (const StringPrim * name, uint32_t index, bool own, Object ** propObj, Property ** desc)
+{
+    Object * obj = this;
+    do {
+        if (Property * p = obj->getOwnProperty(name)) {
+            *propObj = obj;
+            *desc = p;
+            return 1;
+        }
+        if (obj->elements ? obj->elements->find(index) != NULL :
+            obj->hasClassBits(CLS_INDEXED) && static_cast<IndexedObject *>(obj)->hasIndex(index))
+        {
+            *propObj = obj;
+            *desc = NULL;
+            return 2;
+        }
+    } while (!own && (obj = obj->parent) != NULL);
+    return 0;
+}
+
+void Object::addElement (StackFrame * caller, uint32_t index, TaggedValue v)
+{
+    if (!this->elements)
+        this->elements = new ObjectElements();
+    this->elements->add(index, v);
+    ++this->propVersion;
+    if (this->flags & OF_PROTOTYPE)
+        JS_GET_RUNTIME(caller)->invalidatePropCache();
+}
+
+bool Object::deleteElement (StackFrame * caller, uint32_t index)
+{
+    if (!this->elements || !this->elements->find(index))
+        return true;
+    if (this->flags & OF_NOCONFIG) {
+        if (JS_IS_STRICT_MODE(caller))
+            throwTypeError(caller, "Property '%lu' is not deletable", (unsigned long)index);
+        return false;
+    }
+    this->elements->erase(index);
+    ++this->propVersion;
+    if (this->flags & OF_PROTOTYPE)
+        JS_GET_RUNTIME(caller)->invalidatePropCache();
+    return true;
+}
+
 bool Object::hasComputed (StackFrame * caller, TaggedValue propName, bool own)
 {
+    uint32_t index;
+    TaggedValue * pv;
+    int res;
+    // Fast path
+    if (JS_LIKELY(isValidArrayIndexNumber(propName, &index)) && (res = findElement(index, own, &pv)) >= 0)
+        return res != 0;
+
     StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":Object::hasComputed()", __LINE__);
     frame.locals[0] = toString(&frame, propName);
-    return JS_LIKELY(!own) ?
-        this->hasProperty(frame.locals[0].raw.sval) : this->hasOwnProperty(frame.locals[0].raw.sval);
+    const StringPrim * name = frame.locals[0].raw.sval;
+
+    if (name->isIndex(&index)) {
+        Object * propObj;
+        Property * p;
+        return findIndexProperty(name, index, own, &propObj, &p) != 0;
+    }
+
+    return JS_LIKELY(!own) ? this->hasProperty(name) : this->hasOwnProperty(name);
 }
 
 TaggedValue Object::getComputed (StackFrame * caller, TaggedValue propName, bool own)
 {
+    uint32_t index;
+    TaggedValue * pv;
+    // Fast path
+    if (JS_LIKELY(isValidArrayIndexNumber(propName, &index))) {
+        int res = findElement(index, own, &pv);
+        if (JS_LIKELY(res > 0))
+            return *pv;
+        else if (res == 0)
+            return JS_UNDEFINED_VALUE;
+    }
+
     StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":Object::getComputed()", __LINE__);
     frame.locals[0] = toString(&frame, propName);
-    return JS_LIKELY(!own) ?
-        this->get(&frame, frame.locals[0].raw.sval) : this->getOwn(&frame, frame.locals[0].raw.sval);
+    const StringPrim * name = frame.locals[0].raw.sval;
+
+    if (name->isIndex(&index)) {
+        Object * propObj;
+        Property * p;
+        switch (findIndexProperty(name, index, own, &propObj, &p)) {
+            case 1: return getPropertyValue(&frame, p);
+            case 2: return propObj->elements ?
+                *propObj->elements->find(index) : static_cast<IndexedObject *>(propObj)->getAtIndex(&frame, index);
+        }
+        return JS_UNDEFINED_VALUE;
+    }
+
+    return JS_LIKELY(!own) ? this->get(&frame, name) : this->getOwn(&frame, name);
 }
 
 int Object::getComputedDescriptor (StackFrame * caller, TaggedValue propName, bool own, Property ** desc)
 {
+    uint32_t index;
+    TaggedValue * pv;
+    int res;
+
+    *desc = NULL;
+
+    // Fast path
+    if (JS_LIKELY(isValidArrayIndexNumber(propName, &index)) && (res = findElement(index, own, &pv)) >= 0)
+        return res ? 2 : 0;
+
     StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":Object::getComputed()", __LINE__);
     frame.locals[0] = toString(&frame, propName);
+    const StringPrim * name = frame.locals[0].raw.sval;
 
+    if (name->isIndex(&index)) {
+        Object * propObj;
+        return findIndexProperty(name, index, own, &propObj, desc);
+    }
+
+    ensureProps(&frame);
     Object * propObj;
-    if (Property * p = !own ? getProperty(frame.locals[0].raw.sval, &propObj) : getOwnProperty(frame.locals[0].raw.sval)) {
+    if (Property * p = !own ? getProperty(name, &propObj) : getOwnProperty(name)) {
         *desc = p;
         return 1;
     } else {
-        *desc = NULL;
         return 0;
     }
 }
 
 void Object::putComputed (StackFrame * caller, TaggedValue propName, TaggedValue v)
 {
+    uint32_t index;
+    TaggedValue * pv;
+    // Fast path
+    if (JS_LIKELY(isValidArrayIndexNumber(propName, &index)) &&
+        JS_LIKELY(!(this->flags & (OF_NOEXTEND | OF_NOWRITE | OF_INDEX_PROPERTIES))))
+    {
+        if (this->elements && (pv = this->elements->find(index)) != NULL) {
+            *pv = v;
+            return;
+        }
+        // The elements of the ancestors don't matter, since they are always writable
+        if (!this->parent || this->parent->findElement(index, false, &pv) >= 0) {
+            addElement(caller, index, v);
+            return;
+        }
+    }
+
     StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":Object::putComputed()", __LINE__);
     frame.locals[0] = toString(&frame, propName);
-    this->put(&frame, frame.locals[0].raw.sval, v);
+    const StringPrim * name = frame.locals[0].raw.sval;
+
+    if (name->isIndex(&index) && !hasClassBits(CLS_INDEXED) && !(this->flags & OF_NOWRITE)) {
+        Object * propObj;
+        Property * p;
+        switch (findIndexProperty(name, index, false, &propObj, &p)) {
+            case 1:
+                if (updatePropertyValue(&frame, propObj, p, v))
+                    return;
+                break;
+            case 2:
+                if (propObj == this) {
+                    *this->elements->find(index) = v;
+                    return;
+                }
+                break;
+        }
+        if (!(this->flags & OF_NOEXTEND)) {
+            addElement(&frame, index, v);
+            return;
+        }
+    }
+
+    // This also reports the errors
+    this->put(&frame, name, v);
 }
 
 bool Object::deleteProperty (StackFrame * caller, const StringPrim * name)
 {
-    auto it = props.find(name->getStr());
-    if (it != props.end()) {
-        if ((this->flags & OF_NOCONFIG) || !(it->second.flags & PROP_CONFIGURABLE)) {
+    ensureProps(caller);
+    if (Property * p = getOwnProperty(name)) {
+        if ((this->flags & OF_NOCONFIG) || !(p->flags & PROP_CONFIGURABLE)) {
             if (JS_IS_STRICT_MODE(caller))
-                throwTypeError(caller, "Property '%s' is not deletable", name);
+                throwTypeError(caller, "Property '%s' is not deletable", name->getStr());
             return false;
         }
-        it->second.remove();
-        props.erase(it);
+        p->remove();
+        if (p >= inlineSlots() && p < inlineSlots() + this->inlineUsed)
+            p->name = NULL; // Mark the inline slot as free
+        else
+            props.erase(p->name->getStr());
+        ++this->propVersion;
+        if (this->flags & OF_PROTOTYPE)
+            JS_GET_RUNTIME(caller)->invalidatePropCache();
     }
     return true;
 }
 
 bool Object::deleteComputed (StackFrame * caller, TaggedValue propName)
 {
+    uint32_t index;
+    // Fast path
+    if (JS_LIKELY(isValidArrayIndexNumber(propName, &index)) && !(this->flags & OF_INDEX_PROPERTIES))
+        return deleteElement(caller, index);
+
     StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":Object::deleteComputed()", __LINE__);
     frame.locals[0] = toString(&frame, propName);
-    return this->deleteProperty(&frame, frame.locals[0].raw.sval);
+    const StringPrim * name = frame.locals[0].raw.sval;
+
+    if (this->elements && name->isIndex(&index) && this->elements->find(index))
+        return deleteElement(&frame, index);
+
+    return this->deleteProperty(&frame, name);
 }
 
 Array * Object::ownKeys (StackFrame * caller)
 {
-    StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":objectKeys()", __LINE__);
+    StackFrameN<0,2,0> frame(caller, NULL, __FILE__ ":objectKeys()", __LINE__);
 
-    // Count the elements
-    unsigned n = 0;
-    for ( const ListEntry * entry = this->propList.next; entry != &this->propList; entry = entry->next ) {
-        const Property * prop = static_cast<const Property *>(entry);
-        if ((prop->flags & PROP_ENUMERABLE) != 0)
-            ++n;
-    }
+    EnumCache * ec = getEnumCache(&frame);
+    frame.locals[1] = makeMemoryValue(VT_MEMORY, ec);
 
     Array * a;
     frame.locals[0] = js::makeObjectValue(a = new(&frame) Array(JS_GET_RUNTIME(caller)->arrayPrototype));
     a->init(&frame);
 
-    // Try to be just a tad smarter here to avoid initializing the array redundantly
-    a->elems.reserve(n);
+    unsigned n = ec->ownCount;
+    a->elems.resize(n);
+    for ( unsigned i = 0; i < n; ++i )
+        a->elems[i] = js::makeStringValue(ec->names[i]);
+
+    return a;
+}
+
+EnumCache * Object::getEnumCache (StackFrame * caller)
+{
+    Runtime * r = JS_GET_RUNTIME(caller);
+    // An inherited enumerable name could be shadowed by one of the lazy properties
+    ensureProps(caller);
+
+    bool haveElements = this->elements && this->elements->count;
+
+    // Most of the time objects enumerated in a loop have the same parent and the same properties
+    if (this->parent && !haveElements) {
+        EnumCache * ec = this->parent->enumCache;
+        if (ec && ec->protoEpoch == r->protoEpoch && ec->matchesOwn(this))
+            return ec;
+    }
+
+    StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":Object::getEnumCache()", __LINE__);
+    EnumCache * ec;
+    frame.locals[0] = makeMemoryValue(VT_MEMORY, ec = new(&frame) EnumCache());
+
+    // Elements come first, in ascending order
+    std::vector<uint32_t> indexes;
+    if (haveElements) {
+        this->elements->getIndexes(indexes);
+        for ( uint32_t index : indexes )
+            ec->names.push_back(toString(&frame, index).raw.sval);
+        ec->hasElements = true;
+    }
+
+    // Objects with elements don't share their names with the siblings
+    bool allEnumerable = !haveElements;
     for ( const ListEntry * entry = this->propList.next; entry != &this->propList; entry = entry->next ) {
         const Property * prop = static_cast<const Property *>(entry);
         if ((prop->flags & PROP_ENUMERABLE) != 0)
-            a->elems.push_back(js::makeStringValue(prop->name));
+            ec->names.push_back(prop->name);
+        else
+            allEnumerable = false;
+    }
+    ec->ownCount = (unsigned)ec->names.size();
+    ec->protoEpoch = r->protoEpoch;
+
+    // Usually the ancestors don't have any enumerable properties, so we can avoid checking for shadowing
+    bool inherited = false;
+    for ( const Object * obj = this->parent; obj && !inherited; obj = obj->parent ) {
+        if (obj->elements && obj->elements->count) {
+            inherited = true;
+            ec->hasElements = true;
+            break;
+        }
+        for ( const ListEntry * entry = obj->propList.next; entry != &obj->propList; entry = entry->next )
+            if (static_cast<const Property *>(entry)->flags & PROP_ENUMERABLE) {
+                inherited = true;
+                break;
+            }
     }
 
-    assert(a->getLength() == n);
-    return a;
+    if (inherited) {
+        // Names are interned, so we can compare the pointers. Elements are compared by index.
+        std::set<const StringPrim *> used;
+        std::set<uint32_t> usedIndexes(indexes.begin(), indexes.end());
+        const Object * obj = this;
+        do {
+            if (obj != this && obj->elements && obj->elements->count) {
+                indexes.clear();
+                obj->elements->getIndexes(indexes);
+                for ( uint32_t index : indexes )
+                    if (usedIndexes.insert(index).second)
+                        ec->names.push_back(toString(&frame, index).raw.sval);
+            }
+            for ( const ListEntry * entry = obj->propList.next; entry != &obj->propList; entry = entry->next ) {
+                const Property * prop = static_cast<const Property *>(entry);
+                uint32_t index;
+                bool isNew = ec->hasElements && prop->name->isIndex(&index) ?
+                    usedIndexes.insert(index).second : used.insert(prop->name).second;
+                // NOTE: non-enumerable properties in descendants hide enumerable properties in ancestors, so
+                // we add then in 'used' even if we don't add them to names
+                if (isNew && obj != this && (prop->flags & PROP_ENUMERABLE) != 0)
+                    ec->names.push_back(prop->name);
+            }
+        } while ((obj = obj->parent) != NULL);
+    }
+
+    if (this->parent && allEnumerable)
+        this->parent->enumCache = ec;
+
+    return ec;
 }
 
 uintptr_t Object::getInternalProp (unsigned index) const
@@ -509,20 +916,15 @@ NativeObject * NativeObject::make (StackFrame * caller, unsigned internalPropCou
 
 NativeObject::NativeObject (Object * parent, unsigned internalCount) :
     Object(parent),
-    icls(ICLS_OBJECT),
     initTag(NULL),
     nativeFinalizer(NULL),
     internalCount(internalCount)
 {
+   this->clsBits |= CLS_NATIVE;
    memset(this->internalProps, 0, sizeof(this->internalProps[0])*internalCount);
 }
 
-InternalClass NativeObject::getInternalClass () const
-{
-    return this->icls;
-}
-
-Object * NativeObject::createDescendant (StackFrame * caller)
+Object * NativeObject::createDescendant (StackFrame * caller, AllocSite *)
 {
     NativeObject * obj = NativeObject::make(caller, this, this->internalCount);
     obj->icls = this->icls;
@@ -573,12 +975,12 @@ bool IndexedObject::hasComputed (StackFrame * caller, TaggedValue propName, bool
         if (!own ? hasProperty(frame.locals[0].raw.sval) : hasOwnProperty(frame.locals[0].raw.sval))
             return true;
 
-        if (isIndexString(frame.locals[0].raw.sval->getStr(), &index))
+        if (frame.locals[0].raw.sval->isIndex(&index))
             return hasIndex(index);
 
         return false;
     } else {
-        if (isIndexString(frame.locals[0].raw.sval->getStr(), &index))
+        if (frame.locals[0].raw.sval->isIndex(&index))
             return hasIndex(index);
 
         return !own ? hasProperty(frame.locals[0].raw.sval) : hasOwnProperty(frame.locals[0].raw.sval);
@@ -601,12 +1003,12 @@ TaggedValue IndexedObject::getComputed (StackFrame * caller, TaggedValue propNam
         if (Property * p = !own ? getProperty(frame.locals[0].raw.sval, &propObj) : getOwnProperty(frame.locals[0].raw.sval))
             return getPropertyValue(&frame, p);
 
-        if (isIndexString(frame.locals[0].raw.sval->getStr(), &index))
+        if (frame.locals[0].raw.sval->isIndex(&index))
             return getAtIndex(&frame, index);
 
         return JS_UNDEFINED_VALUE;
     } else {
-        if (isIndexString(frame.locals[0].raw.sval->getStr(), &index))
+        if (frame.locals[0].raw.sval->isIndex(&index))
             return getAtIndex(&frame, index);
 
         return this->get(&frame, frame.locals[0].raw.sval);
@@ -635,12 +1037,12 @@ int IndexedObject::getComputedDescriptor (StackFrame * caller, TaggedValue propN
             return 1;
         }
 
-        if (isIndexString(frame.locals[0].raw.sval->getStr(), &index))
+        if (frame.locals[0].raw.sval->isIndex(&index))
             return hasIndex(index) ? 2 : 0;
 
         return 0;
     } else {
-        if (isIndexString(frame.locals[0].raw.sval->getStr(), &index))
+        if (frame.locals[0].raw.sval->isIndex(&index))
             return hasIndex(index) ? 2 : 0;
 
         Object * propObj;
@@ -679,7 +1081,7 @@ void IndexedObject::putComputed (StackFrame * caller, TaggedValue propName, Tagg
             return;
     }
 
-    if (isIndexString(frame.locals[0].raw.sval->getStr(), &index)) {
+    if (frame.locals[0].raw.sval->isIndex(&index)) {
         if (JS_UNLIKELY(!setAtIndex(caller, index, v) && JS_IS_STRICT_MODE(caller)))
             throwTypeError(caller, "cannot modify property [%lu]", (unsigned long)index);
         return;
@@ -704,7 +1106,7 @@ bool IndexedObject::deleteComputed (StackFrame * caller, TaggedValue propName)
         if (JS_LIKELY(frame.locals[0].tag == VT_UNDEFINED)) // if we didn't already convert it to string
             frame.locals[0] = toString(&frame, propName);
 
-        if (!isIndexString(frame.locals[0].raw.sval->getStr(), &index))
+        if (!frame.locals[0].raw.sval->isIndex(&index))
             return this->deleteProperty(&frame, frame.locals[0].raw.sval);
     }
 
@@ -715,6 +1117,14 @@ bool IndexedObject::deleteComputed (StackFrame * caller, TaggedValue propName)
     return res;
 }
 
+uint32_t IndexedObject::nextIndex (uint32_t from) const
+{
+    uint32_t length = getIndexedLength();
+    while (from < length && !hasIndex(from))
+        ++from;
+    return from < length ? from : length;
+}
+
 Array * IndexedObject::ownKeys (StackFrame * caller)
 {
     StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":objectKeys()", __LINE__);
@@ -724,7 +1134,7 @@ Array * IndexedObject::ownKeys (StackFrame * caller)
     uint32_t n = 0;
 
     // First count only the real indexed properties
-    for ( uint32_t i = 0; i < length; ++i ) {
+    for ( uint32_t i = nextIndex(0); i < length; i = nextIndex(i + 1) ) {
         Property * prop;
         if (getComputedDescriptor(&frame, makeNumberValue(i), true, &prop) == 2)
             ++n;
@@ -743,7 +1153,7 @@ Array * IndexedObject::ownKeys (StackFrame * caller)
     // Try to be just a tad smarter here to avoid initializing the array redundantly
     a->elems.reserve(n);
 
-    for ( uint32_t i = 0; i < length; ++i ) {
+    for ( uint32_t i = nextIndex(0); i < length; i = nextIndex(i + 1) ) {
         Property * prop;
         TaggedValue const & name = makeNumberValue(i);
         if (getComputedDescriptor(&frame, name, true, &prop) == 2) {
@@ -761,70 +1171,287 @@ Array * IndexedObject::ownKeys (StackFrame * caller)
     return a;
 }
 
+ArrayBase::~ArrayBase ()
+{
+    delete sparse;
+}
+
 bool ArrayBase::mark (IMark * marker, unsigned markBit) const
 {
     if (!super::mark(marker, markBit))
         return false;
+    // Numbers and holes don't point to anything
+    if (numbersOnly)
+        return true;
+    if (JS_UNLIKELY(sparse != NULL)) {
+        for (const auto & entry : *sparse)
+            if (!markValue(marker, markBit, entry.second))
+                return false;
+        return true;
+    }
     for (const auto & value : elems)
         if (!markValue(marker, markBit, value))
             return false;
     return true;
 }
 
-void ArrayBase::setLength (unsigned newLen)
+static uint32_t countHoles (const TaggedValue * from, const TaggedValue * to)
 {
-    elems.resize(newLen, TaggedValue{VT_ARRAY_HOLE});
+    uint32_t count = 0;
+    for ( ; from != to; ++from )
+        if (from->tag == VT_ARRAY_HOLE)
+            ++count;
+    return count;
 }
 
-void ArrayBase::setElem (unsigned index, TaggedValue v)
+/** Should an array of the specified length with 'count' existing elements be sparse */
+static inline bool wantSparse (uint32_t length, uint32_t count)
 {
-    if (index >= elems.size())
-        setLength(index + 1);
-    elems[index] = v;
+    uint32_t holes = length - count;
+    return holes > ArrayBase::SPARSE_MIN_HOLES && holes > count;
 }
 
-uint32_t ArrayBase::getIndexedLength () const
-{
-    return getLength();
-}
-bool ArrayBase::hasIndex (uint32_t index) const
-{
-    return hasElem(index);
-}
-TaggedValue ArrayBase::getAtIndex (StackFrame *, uint32_t index) const
+void ArrayBase::makeSparse ()
 {
-    return getElem(index);
+    assert(!sparse);
+    sparse = new std::map<uint32_t, TaggedValue>();
+    uint32_t len = elems.size();
+    for ( uint32_t i = 0; i < len; ++i )
+        if (elems[i].tag != VT_ARRAY_HOLE)
+            sparse->emplace_hint(sparse->end(), i, elems[i]);
+    sparseLength = len;
+    holeCount = len - sparse->size();
+    elems.release();
 }
-bool ArrayBase::setAtIndex (StackFrame *,uint32_t index, TaggedValue value)
+
+void ArrayBase::makeDense ()
 {
-    setElem(index, value);
-    return true;
+    assert(sparse && elems.empty());
+    elems.resize(sparseLength, JS_ARRAY_HOLE_VALUE);
+    for (const auto & entry : *sparse)
+        elems[entry.first] = entry.second;
+    holeCount = sparseLength - sparse->size();
+    delete sparse;
+    sparse = NULL;
+    sparseLength = 0;
 }
-bool ArrayBase::deleteAtIndex (uint32_t index)
+
+void ArrayBase::setLength (unsigned newLen)
 {
-    if (JS_LIKELY(index) < this->elems.size()) {
-        TaggedValue * pe = &this->elems[index];
-        if (JS_LIKELY(pe->tag != VT_ARRAY_HOLE)) {
-            if (JS_LIKELY(!(this->flags & OF_NOCONFIG))) {
-                *pe = TaggedValue{VT_ARRAY_HOLE};
-            } else {
-                return false;
-            }
+    if (JS_UNLIKELY(sparse != NULL)) {
+        if (newLen < sparseLength)
+            sparse->erase(sparse->lower_bound(newLen), sparse->end());
+        sparseLength = newLen;
+        holeCount = newLen - sparse->size();
+        if (!wantSparse(newLen, sparse->size()))
+            makeDense();
+        return;
+    }
+
+    uint32_t oldLen = elems.size();
+    if (newLen > oldLen) {
+        uint32_t holes = holeCount + (newLen - oldLen);
+        if (JS_UNLIKELY(wantSparse(newLen, newLen - holes))) {
+            makeSparse();
+            sparseLength = newLen;
+            holeCount = newLen - sparse->size();
+            return;
         }
+        holeCount = holes;
+    } else if (newLen == 0) {
+        holeCount = 0;
+    } else if (holeCount != 0) {
+        // Count through a const reference, so a shared vector isn't copied just to be truncated
+        const ElementVector & ce = elems;
+        holeCount -= countHoles(ce.data() + newLen, ce.data() + oldLen);
     }
-    return true;
+    elems.resize(newLen, JS_ARRAY_HOLE_VALUE);
 }
 
-void Array::init (StackFrame * caller)
+void ArrayBase::setSparseElem (unsigned index, TaggedValue v)
 {
-    super::init(caller);
-    Runtime * r = JS_GET_RUNTIME(caller);
-    defineOwnProperty(caller, r->permStrLength, PROP_WRITEABLE|PROP_GET_SET, r->arrayLengthAccessor);
-}
+    if (index >= sparseLength)
+        sparseLength = index + 1;
 
-InternalClass Array::getInternalClass () const
-{
-    return ICLS_ARRAY;
+    if (JS_UNLIKELY(v.tag == VT_ARRAY_HOLE)) {
+        sparse->erase(index);
+    } else {
+        if (v.tag != VT_NUMBER)
+            numbersOnly = false;
+        auto res = sparse->emplace(index, v);
+        if (!res.second)
+            res.first->second = v;
+    }
+
+    holeCount = sparseLength - sparse->size();
+    if (!wantSparse(sparseLength, sparse->size()))
+        makeDense();
+}
+
+void ArrayBase::setElem (unsigned index, TaggedValue v)
+{
+    if (index >= elems.size()) {
+        if (!sparse)
+            setLength(index + 1);
+        if (JS_UNLIKELY(sparse != NULL)) {
+            setSparseElem(index, v);
+            return;
+        }
+    }
+    TaggedValue * pe = &elems[index];
+    if (JS_UNLIKELY(holeCount != 0) && pe->tag == VT_ARRAY_HOLE)
+        --holeCount;
+    if (v.tag != VT_NUMBER) {
+        if (JS_UNLIKELY(v.tag == VT_ARRAY_HOLE))
+            ++holeCount;
+        else
+            numbersOnly = false;
+    }
+    *pe = v;
+}
+
+void ArrayBase::copyElems (uint32_t destIndex, const ArrayBase * src, uint32_t srcFrom, uint32_t srcTo)
+{
+    assert(srcFrom <= srcTo && srcTo <= src->getLength() && destIndex + (srcTo - srcFrom) <= getLength());
+    uint32_t count = srcTo - srcFrom;
+
+    if (JS_UNLIKELY(sparse || src->sparse)) {
+        // Only visit the existing elements. They are collected first, since the ranges may overlap
+        std::vector<std::pair<uint32_t, TaggedValue>> present;
+        for ( uint32_t i = src->nextIndex(srcFrom); i < srcTo; i = src->nextIndex(i + 1) )
+            present.emplace_back(i - srcFrom, src->getElem(i));
+
+        uint32_t destTo = destIndex + count;
+        if (sparse) {
+            sparse->erase(sparse->lower_bound(destIndex), sparse->lower_bound(destTo));
+            holeCount = sparseLength - sparse->size();
+        } else {
+            for ( TaggedValue * pe = elems.data() + destIndex, * end = elems.data() + destTo; pe != end; ++pe ) {
+                if (pe->tag != VT_ARRAY_HOLE) {
+                    *pe = JS_ARRAY_HOLE_VALUE;
+                    ++holeCount;
+                }
+            }
+        }
+
+        for (const auto & entry : present)
+            setElem(destIndex + entry.first, entry.second);
+        return;
+    }
+
+    TaggedValue * dest = elems.data() + destIndex;
+    const TaggedValue * from = src->elems.data() + srcFrom;
+
+    // Both ranges are counted before copying, since they may overlap
+    uint32_t removed = holeCount != 0 ? countHoles(dest, dest + count) : 0;
+    uint32_t added = src->holeCount != 0 ? countHoles(from, from + count) : 0;
+    holeCount = holeCount - removed + added;
+    numbersOnly &= src->numbersOnly;
+
+    ::memmove(dest, from, sizeof(TaggedValue) * count);
+}
+
+void ArrayBase::append (const TaggedValue * values, unsigned count)
+{
+    if (JS_UNLIKELY(sparse != NULL)) {
+        for ( unsigned i = 0; i != count; ++i )
+            setElem(getLength(), values[i]);
+        return;
+    }
+
+    for ( unsigned i = 0; i != count; ++i ) {
+        if (values[i].tag != VT_NUMBER) {
+            if (JS_UNLIKELY(values[i].tag == VT_ARRAY_HOLE))
+                ++holeCount;
+            else
+                numbersOnly = false;
+        }
+    }
+    elems.append(values, values + count);
+}
+
+void ArrayBase::removeFront (uint32_t count)
+{
+    uint32_t len = getLength();
+    assert(count <= len);
+    if (JS_UNLIKELY(sparse != NULL)) {
+        copyElems(0, this, count, len);
+        setLength(len - count);
+        return;
+    }
+
+    if (holeCount != 0) {
+        const ElementVector & ce = elems;
+        holeCount -= countHoles(ce.data(), ce.data() + count);
+    }
+    elems.dropFront(count);
+}
+
+uint32_t ArrayBase::getIndexedLength () const
+{
+    return getLength();
+}
+bool ArrayBase::hasIndex (uint32_t index) const
+{
+    return hasElem(index);
+}
+TaggedValue ArrayBase::getAtIndex (StackFrame *, uint32_t index) const
+{
+    return getElem(index);
+}
+bool ArrayBase::setAtIndex (StackFrame *,uint32_t index, TaggedValue value)
+{
+    setElem(index, value);
+    return true;
+}
+bool ArrayBase::deleteAtIndex (uint32_t index)
+{
+    if (JS_UNLIKELY(sparse != NULL)) {
+        auto it = sparse->find(index);
+        if (it != sparse->end()) {
+            if (JS_UNLIKELY(this->flags & OF_NOCONFIG))
+                return false;
+            sparse->erase(it);
+            ++this->holeCount;
+        }
+        return true;
+    }
+
+    if (JS_LIKELY(index < this->elems.size())) {
+        TaggedValue * pe = &this->elems[index];
+        if (JS_LIKELY(pe->tag != VT_ARRAY_HOLE)) {
+            if (JS_LIKELY(!(this->flags & OF_NOCONFIG))) {
+                *pe = JS_ARRAY_HOLE_VALUE;
+                ++this->holeCount;
+            } else {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+uint32_t ArrayBase::nextIndex (uint32_t from) const
+{
+    if (JS_UNLIKELY(sparse != NULL)) {
+        auto it = sparse->lower_bound(from);
+        return it != sparse->end() ? it->first : sparseLength;
+    }
+
+    uint32_t len = elems.size();
+    if (from >= len)
+        return len;
+    if (JS_LIKELY(isPacked()))
+        return from;
+    while (from < len && elems[from].tag == VT_ARRAY_HOLE)
+        ++from;
+    return from;
+}
+
+void Array::init (StackFrame * caller)
+{
+    super::init(caller);
+    Runtime * r = JS_GET_RUNTIME(caller);
+    defineOwnProperty(caller, r->permStrLength, PROP_WRITEABLE|PROP_GET_SET, r->arrayLengthAccessor);
 }
 
 Array * Array::findArrayInstance (StackFrame * caller, TaggedValue thisp)
@@ -868,50 +1495,67 @@ void Arguments::init (StackFrame * caller, int argc, const TaggedValue * argv)
                       makeNumberValue(argc));
 }
 
-InternalClass Arguments::getInternalClass () const
+bool EnumCache::mark (IMark * marker, unsigned markBit) const
 {
-    return ICLS_ARGUMENTS;
+    for ( const auto & it : names )
+        if (!markMemory(marker, markBit, it))
+            return false;
+    return true;
 }
 
-bool ForInIterator::mark (IMark * marker, unsigned markBit) const
+bool EnumCache::matchesOwn (const Object * obj) const
 {
-    if (!markMemory(marker, markBit, m_obj))
-        return false;
-    // We could only mark the names that haven't been enumerated yet, but why??
-    for ( const auto & it : m_propNames )
-        if (!markMemory(marker, markBit, it))
+    const StringPrim * const * pname = this->names.data();
+    const StringPrim * const * ename = pname + this->ownCount;
+    for ( const ListEntry * entry = obj->propList.next; entry != &obj->propList; entry = entry->next ) {
+        const Property * prop = static_cast<const Property *>(entry);
+        if (pname == ename || *pname != prop->name || !(prop->flags & PROP_ENUMERABLE))
             return false;
-    return true;
+        ++pname;
+    }
+    return pname == ename;
+}
+
+bool ForInIterator::mark (IMark * marker, unsigned markBit) const
+{
+    return markMemory(marker, markBit, m_obj) && markMemory(marker, markBit, m_names);
 }
 
 void ForInIterator::initWithObject (StackFrame * caller, Object * obj)
 {
     m_obj = obj;
-    std::set<const StringPrim *, less_StringPrim> used;
-
-    do {
-        for ( const ListEntry * entry = obj->propList.next; entry != &obj->propList; entry = entry->next ) {
-            const Property * prop = static_cast<const Property *>(entry);
-            // NOTE: non-enumerable properties in descendants hide enumerable properties in ancestors, so
-            // we add then in 'used' even if we don't add them to propNames
-            if (used.find(prop->name) == used.end()) {
-                used.insert(prop->name);
-                if ((prop->flags & PROP_ENUMERABLE) != 0)
-                    m_propNames.push_back(prop->name);
-            }
-        }
-    } while ((obj = obj->parent) != NULL);
-
-    m_curName = m_propNames.begin();
+    m_names = obj->getEnumCache(caller);
+    m_curName = 0;
+    m_objVersion = obj->propVersion;
+    m_protoEpoch = m_names->protoEpoch;
 }
 
 bool ForInIterator::next (StackFrame * caller, TaggedValue * result)
 {
-    while (JS_LIKELY(m_curName != m_propNames.end())) {
-        Object * propObj;
-        Property * prop = m_obj->getProperty(*m_curName++, &propObj);
-        if (JS_LIKELY(prop != NULL && (prop->flags & PROP_ENUMERABLE))) {
-            *result = makeStringValue(prop->name);
+    const std::vector<const StringPrim *> & names = m_names->names;
+
+    // If nothing has changed since we started, the remaining names are all valid
+    if (JS_LIKELY(m_obj->propVersion == m_objVersion && JS_GET_RUNTIME(caller)->protoEpoch == m_protoEpoch)) {
+        if (m_curName < names.size()) {
+            *result = makeStringValue(names[m_curName++]);
+            return true;
+        }
+        return false;
+    }
+
+    while (JS_LIKELY(m_curName < names.size())) {
+        const StringPrim * name = names[m_curName++];
+        Property * prop;
+        int res;
+        if (JS_UNLIKELY(m_names->hasElements)) {
+            // Elements can only be found by the computed lookup
+            res = m_obj->getComputedDescriptor(caller, makeStringValue(name), false, &prop);
+        } else {
+            Object * propObj;
+            res = (prop = m_obj->getProperty(name, &propObj)) != NULL;
+        }
+        if (JS_LIKELY(res == 2 || (res == 1 && (prop->flags & PROP_ENUMERABLE)))) {
+            *result = makeStringValue(name);
             return true;
         }
     }
@@ -931,12 +1575,14 @@ bool ForInIndexedIterator::next (StackFrame * caller, TaggedValue * result)
 {
     if (JS_LIKELY(m_indexed)) {
         if (JS_LIKELY(!(m_obj->flags & OF_INDEX_PROPERTIES))) {
-            for ( uint32_t index; (index = m_curIndex++) < m_length; ) {
-                if (m_indexed->hasIndex(index)) {
-                    *result = toString(caller, index);
-                    return true;
-                }
+            // Elements appended after the enumeration started are not visited
+            uint32_t index = m_curIndex < m_length ? m_indexed->nextIndex(m_curIndex) : m_length;
+            if (index < m_length) {
+                m_curIndex = index + 1;
+                *result = toString(caller, index);
+                return true;
             }
+            m_curIndex = m_length;
         } else {
             StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":ForInIndexedIterator::next", __LINE__);
 
@@ -964,39 +1610,76 @@ bool ForInIndexedIterator::next (StackFrame * caller, TaggedValue * result)
     return super::next(caller, result);
 }
 
-void Function::init (StackFrame * caller, Env * env, CodePtr code, CodePtr consCode, const StringPrim * name, unsigned length)
+/**
+ * Add the properties which every function has. Extensibility is not checked, because a lazily
+ * initialized function could have been frozen before its properties were created.
+ */
+static void addFunctionProps (StackFrame * caller, Function * func, const StringPrim * name)
 {
-    super::init(caller);
-
     Runtime * r = JS_GET_RUNTIME(caller);
 
-    this->env = env;
-    this->code = code;
-    this->consCode = consCode;
     if (!name)
         name = r->permStrEmpty;
-    this->length = length;
-    defineOwnProperty(caller, r->permStrLength, 0, makeNumberValue(length));
-    defineOwnProperty(caller, r->permStrName, 0, makeStringValue(name));
+    func->addOwnProperty(caller, r->permStrLength, 0, makeNumberValue(func->length));
+    func->addOwnProperty(caller, r->permStrName, 0, makeStringValue(name));
     if (r->strictMode) {
-        defineOwnProperty(caller, r->permStrCaller, PROP_GET_SET, r->strictThrowerAccessor);
-        defineOwnProperty(caller, r->permStrCallee, PROP_GET_SET, r->strictThrowerAccessor);
-        defineOwnProperty(caller, r->permStrArguments, PROP_GET_SET, r->strictThrowerAccessor);
+        func->addOwnProperty(caller, r->permStrCaller, PROP_GET_SET, r->strictThrowerAccessor);
+        func->addOwnProperty(caller, r->permStrCallee, PROP_GET_SET, r->strictThrowerAccessor);
+        func->addOwnProperty(caller, r->permStrArguments, PROP_GET_SET, r->strictThrowerAccessor);
     } else {
-        defineOwnProperty(caller, r->permStrCaller, PROP_WRITEABLE, JS_NULL_VALUE);
-        defineOwnProperty(caller, r->permStrCallee, PROP_WRITEABLE, JS_NULL_VALUE);
-        defineOwnProperty(caller, r->permStrArguments, PROP_WRITEABLE, JS_NULL_VALUE);
+        func->addOwnProperty(caller, r->permStrCaller, PROP_WRITEABLE, JS_NULL_VALUE);
+        func->addOwnProperty(caller, r->permStrCallee, PROP_WRITEABLE, JS_NULL_VALUE);
+        func->addOwnProperty(caller, r->permStrArguments, PROP_WRITEABLE, JS_NULL_VALUE);
     }
 }
 
-InternalClass Function::getInternalClass () const
+void Function::init (StackFrame * caller, Env * env, CodePtr code, CodePtr consCode, const StringPrim * name, unsigned length)
+{
+    super::init(caller);
+
+    this->env = env;
+    this->code = code;
+    this->consCode = consCode;
+    this->length = length;
+    addFunctionProps(caller, this, name);
+}
+
+void Function::materializeProps (StackFrame * caller)
+{
+    assert(this->flags & OF_LAZY_PROPS);
+    StackFrameN<0,2,0> frame(caller, NULL, __FILE__ ":Function::materializeProps", __LINE__);
+    Runtime * r = JS_GET_RUNTIME(&frame);
+    frame.locals[0] = makeObjectValue(this);
+
+    this->flags &= ~OF_LAZY_PROPS;
+    addFunctionProps(&frame, this, this->lazyName);
+    this->lazyName = NULL;
+
+    Object * prototype = newInit<Object>(&frame, &frame.locals[1], r->objectPrototype);
+    prototype->defineOwnProperty(&frame, r->permStrConstructor, PROP_WRITEABLE | PROP_CONFIGURABLE, frame.locals[0]);
+    addOwnProperty(&frame, r->permStrPrototype, PROP_WRITEABLE, frame.locals[1]);
+}
+
+bool Function::isLazyPropName (const StringPrim * name)
 {
-    return ICLS_FUNCTION;
+    Runtime * r = JS_GET_RUNTIME(NULL);
+    const StringPrim * lazyNames[] = {
+        r->permStrLength, r->permStrName, r->permStrCaller, r->permStrCallee, r->permStrArguments,
+        r->permStrPrototype
+    };
+    for ( const StringPrim * lazyName : lazyNames ) {
+        if (lazyName == name)
+            return true;
+        if (!name->isInterned() && strcmp(lazyName->getStr(), name->getStr()) == 0)
+            return true;
+    }
+    return false;
 }
 
 bool Function::mark (IMark * marker, unsigned markBit) const
 {
-    return super::mark(marker, markBit) && markMemory(marker, markBit, env);
+    return super::mark(marker, markBit) && markMemory(marker, markBit, env) &&
+        markMemory(marker, markBit, lazyName);
 }
 
 void Function::definePrototype (StackFrame * caller, Object * prototype, unsigned propFlags)
@@ -1004,15 +1687,44 @@ void Function::definePrototype (StackFrame * caller, Object * prototype, unsigne
     defineOwnProperty(caller, JS_GET_RUNTIME(caller)->permStrPrototype, propFlags, makeObjectValue(prototype));
 }
 
-bool Function::hasInstance (StackFrame * caller, Object * inst)
+bool Function::hasInstance (StackFrame * caller, Object * inst, InstanceOfSite * site)
 {
-    TaggedValue prototype = this->get(caller, JS_GET_RUNTIME(caller)->permStrPrototype);
+    TaggedValue prototype;
+    if (JS_LIKELY(this->protoProp != NULL)) {
+        prototype = this->protoProp->value;
+    } else {
+        Runtime * r = JS_GET_RUNTIME(caller);
+        ensureProps(caller);
+        Property * p = getOwnProperty(r->permStrPrototype);
+        if (p && !(p->flags & (PROP_CONFIGURABLE | PROP_GET_SET)) && !(this->flags & OF_LAZY_PROPS)) {
+            this->protoProp = p;
+            prototype = p->value;
+        } else {
+            prototype = this->get(caller, r->permStrPrototype);
+        }
+    }
     if (!isValueTagObject(prototype.tag))
         throwTypeError(caller, "Function has no valid 'prototype' property");
-    while ((inst = inst->parent) != NULL)
-        if (inst == prototype.raw.oval)
-            return true;
-    return false;
+
+    Object * parent = inst->parent;
+    unsigned gcEpoch = JS_GET_RUNTIME(caller)->gcEpoch;
+    if (site && site->parent == parent && site->prototype == prototype.raw.oval && site->gcEpoch == gcEpoch)
+        return site->result;
+
+    bool result = false;
+    for ( Object * cur = parent; cur != NULL; cur = cur->parent )
+        if (cur == prototype.raw.oval) {
+            result = true;
+            break;
+        }
+
+    if (site) {
+        site->parent = parent;
+        site->prototype = prototype.raw.oval;
+        site->gcEpoch = gcEpoch;
+        site->result = result;
+    }
+    return result;
 }
 
 TaggedValue Function::call (StackFrame * caller, unsigned argc, const TaggedValue * argv)
@@ -1024,7 +1736,7 @@ TaggedValue Function::callCons (StackFrame * caller, unsigned argc, const Tagged
     return (*this->consCode)(caller, this->env, argc, argv);
 }
 
-Object * FunctionCreator::createDescendant (StackFrame * caller)
+Object * FunctionCreator::createDescendant (StackFrame * caller, AllocSite *)
 {
     StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":FunctionCreator::createDescendant()", __LINE__);
     Function * f;
@@ -1058,7 +1770,7 @@ TaggedValue BoundFunction::call (StackFrame * caller, unsigned argc, const Tagge
         return this->target->call(&frame, this->boundCount + count, &frame.locals[0]);
     } else {
         ArrayBase * argSlots = newInit<ArrayBase>(&frame, &frame.locals[0], JS_GET_RUNTIME(&frame)->arrayPrototype);
-        argSlots->setLength(this->boundCount + count);
+        argSlots->elems.resize(this->boundCount + count);
 
         memcpy(&argSlots->elems[0], &this->boundArgs[0], sizeof(argSlots->elems[0]) * this->boundCount);
         memcpy(&argSlots->elems[this->boundCount], argv + 1, sizeof(argSlots->elems[0]) * count);
@@ -1082,7 +1794,7 @@ TaggedValue BoundFunction::callCons (StackFrame * caller, unsigned argc, const T
         return this->target->callCons(&frame, this->boundCount + count, &frame.locals[0]);
     } else {
         ArrayBase * argSlots = newInit<ArrayBase>(&frame, &frame.locals[0], JS_GET_RUNTIME(&frame)->arrayPrototype);
-        argSlots->setLength(this->boundCount + count);
+        argSlots->elems.resize(this->boundCount + count);
 
         argSlots->elems[0] = argv[0]; // copy the supplied 'this'
         if (this->boundCount > 0)
@@ -1093,23 +1805,35 @@ TaggedValue BoundFunction::callCons (StackFrame * caller, unsigned argc, const T
     }
 }
 
-Object * BoundPrototype::createDescendant (StackFrame * caller)
+Object * BoundPrototype::createDescendant (StackFrame * caller, AllocSite * site)
 {
     StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":BoundPrototype::createDescendant", __LINE__);
     frame.locals[0] = this->target->get(&frame, JS_GET_RUNTIME(&frame)->permStrPrototype);
     if (isValueTagObject(frame.locals[0].tag))
-        return frame.locals[0].raw.oval->createDescendant(&frame);
+        return frame.locals[0].raw.oval->createDescendant(&frame, site);
     else
-        return JS_GET_RUNTIME(&frame)->objectPrototype->createDescendant(&frame);
+        return JS_GET_RUNTIME(&frame)->objectPrototype->createDescendant(&frame, site);
 }
 
-InternalClass StringPrim::getInternalClass () const
+StringPrim::~StringPrim ()
 {
-    return ICLS_STRING_PRIM;
+    if (this->stringFlags & F_INDIRECT) {
+        const Indirect * ind = indirect();
+        if (isRope()) {
+            if (ind->chars) // Flattened?
+                releaseExternal((void *)ind->chars, this->byteLength + 1);
+        } else if (this->stringFlags & F_SLICE_COPY) { // Otherwise the characters belong to the parent
+            releaseExternal((void *)ind->chars, this->byteLength + 1);
+        }
+    }
 }
 
 bool StringPrim::mark (IMark * marker, unsigned markBit) const
 {
+    if (JS_UNLIKELY(this->stringFlags & F_INDIRECT)) {
+        const Indirect * ind = indirect();
+        return markMemory(marker, markBit, ind->left) && markMemory(marker, markBit, ind->right);
+    }
     return true;
 }
 
@@ -1118,6 +1842,102 @@ StringPrim * StringPrim::makeEmpty (StackFrame * caller, unsigned length)
     return new(caller, OFFSETOF(StringPrim, _str) + length + 1) StringPrim(length);
 }
 
+StringPrim * StringPrim::makeRope (StackFrame * caller, const StringPrim * left, const StringPrim * right)
+{
+    assert(left->byteLength != 0 && right->byteLength != 0);
+    assert(OFFSETOF(StringPrim, _str) % alignof(Indirect) == 0);
+    Indirect ind = { left, right, NULL };
+    return new(caller, OFFSETOF(StringPrim, _str) + sizeof(Indirect)) StringPrim(
+        F_ROPE, left->byteLength + right->byteLength, left->charLength + right->charLength, ind
+    );
+}
+
+StringPrim * StringPrim::makeSlice (
+    StackFrame * caller, const StringPrim * parent, unsigned offset, unsigned length, unsigned charLength
+)
+{
+    assert(offset + length <= parent->byteLength);
+    const unsigned char * chars = parent->chars() + offset;
+    // Refer to the string which owns the characters instead of building chains of slices
+    if (parent->isSlice() && !(parent->stringFlags & F_SLICE_COPY))
+        parent = parent->indirect()->left;
+    Indirect ind = { parent, NULL, chars };
+    return new(caller, OFFSETOF(StringPrim, _str) + sizeof(Indirect)) StringPrim(F_SLICE, length, charLength, ind);
+}
+
+/**
+ * Assemble the characters of the rope in a buffer and release the parts. The parts can be ropes themselves
+ * (for example "s += x" in a loop builds a chain as long as the loop), so the tree is walked with an explicit
+ * stack, visiting the right part first and filling the buffer from the end.
+ */
+void StringPrim::flatten () const
+{
+    Indirect * ind = indirect();
+    assert(isRope() && ind->left && !ind->chars);
+
+    unsigned char * buf = (unsigned char *)allocateExternal(this->byteLength + 1);
+    if (!buf)
+        throw std::bad_alloc();
+    buf[this->byteLength] = 0;
+
+    unsigned char * dest = buf + this->byteLength;
+    std::vector<const StringPrim *> stack;
+    stack.push_back(ind->left);
+    stack.push_back(ind->right);
+    do {
+        const StringPrim * s = stack.back();
+        stack.pop_back();
+        if (s->isRope() && s->indirect()->chars == NULL) {
+            stack.push_back(s->indirect()->left);
+            stack.push_back(s->indirect()->right);
+        } else {
+            dest -= s->byteLength;
+            memcpy(dest, s->chars(), s->byteLength);
+        }
+    } while (!stack.empty());
+    assert(dest == buf);
+
+    ind->chars = buf;
+    ind->left = NULL;
+    ind->right = NULL;
+}
+
+const char * StringPrim::sliceStr () const
+{
+    const Indirect * ind = indirect();
+    // The slice may happen to be followed by a zero
+    if (ind->chars[this->byteLength] != 0 && !copySlice())
+        throw std::bad_alloc();
+    return (const char *)ind->chars;
+}
+
+/**
+ * The parent stays referenced, because there may be pointers to the characters in it.
+ */
+bool StringPrim::copySlice () const
+{
+    Indirect * ind = indirect();
+    assert(isSlice() && !(this->stringFlags & F_SLICE_COPY));
+
+    unsigned char * buf = (unsigned char *)allocateExternal(this->byteLength + 1);
+    if (!buf)
+        return false;
+    memcpy(buf, ind->chars, this->byteLength);
+    buf[this->byteLength] = 0;
+
+    ind->chars = buf;
+    this->stringFlags |= F_SLICE_COPY;
+    return true;
+}
+
+bool StringPrim::shouldSlice (unsigned length) const
+{
+    const StringPrim * owner = this;
+    if (isSlice() && !(this->stringFlags & F_SLICE_COPY))
+        owner = indirect()->left;
+    return length >= SLICE_MIN_LENGTH && length >= owner->byteLength / SLICE_MAX_WASTE;
+}
+
 StringPrim * StringPrim::makeFromValid (StackFrame * caller, const char * str, unsigned length, unsigned charLength)
 {
     StringPrim * res = makeEmpty(caller, length);
@@ -1153,6 +1973,14 @@ StringPrim * StringPrim::makeFromUnvalidated (StackFrame * caller, const char *
     const unsigned char * s = (const unsigned char *)str;
     const unsigned char * e = (const unsigned char *)str + length;
 
+    // Valid input is by far the common case, and it can be checked and measured in bulk
+    if (JS_LIKELY(utf8IsValid(s, e))) {
+        StringPrim * res = makeEmpty(caller, length);
+        memcpy(res->_str, str, length);
+        res->init(utf8LengthInUTF16Units(s, e));
+        return res;
+    }
+
     while (s < e) {
         ++charLen;
         if (JS_LIKELY(!(*s & 0x80))) { // Plain old ASCII - we love thee!
@@ -1162,7 +1990,10 @@ StringPrim * StringPrim::makeFromUnvalidated (StackFrame * caller, const char *
                 uint32_t cp;
                 const unsigned char * ssav = s;
                 s = utf8Decode(s, &cp);
-                if (JS_UNLIKELY(cp == UNICODE_ERROR)) {
+                if (JS_LIKELY(cp != UNICODE_ERROR)) {
+                    if (cp > 0xFFFF) // Takes a surrogate pair
+                        ++charLen;
+                } else {
                     errors = true;
 
                     // Find the start of the next valid character
@@ -1228,22 +2059,23 @@ StringPrim * StringPrim::makeFromUnvalidated (StackFrame * caller, const char *
 
 const unsigned char * StringPrim::charPos (uint32_t index, bool * secondSurrogate) const
 {
+    const unsigned char * str = chars();
     if (JS_UNLIKELY(index >= this->charLength)) {
         *secondSurrogate = false;
-        return this->_str + this->byteLength;
+        return str + this->byteLength;
     }
 
     unsigned lindex, cpLen;
     const unsigned char * lpos;
 
-    lpos = this->_str + this->lastPos;
+    lpos = str + this->lastPos;
     lindex = this->lastIndex;
 
     if (index == lindex) {
         // nothing
     } else {
         if (index < lindex) {
-            lpos = this->_str;
+            lpos = str;
             lindex = 0;
         }
         cpLen = 0;
@@ -1257,14 +2089,14 @@ const unsigned char * StringPrim::charPos (uint32_t index, bool * secondSurrogat
             // Get back to the beginning of the codepoint
             lpos -= cpLen;
             lindex -= (cpLen >> 2)+1;
-            this->lastPos = lpos - this->_str;
+            this->lastPos = lpos - str;
             this->lastIndex = lindex;
 
             *secondSurrogate = true;
             return lpos;
         }
 
-        this->lastPos = lpos - this->_str;
+        this->lastPos = lpos - str;
         this->lastIndex = lindex;
     }
 
@@ -1274,6 +2106,7 @@ const unsigned char * StringPrim::charPos (uint32_t index, bool * secondSurrogat
 
 uint32_t StringPrim::byteOffsetToUTF16Index (unsigned offset) const
 {
+    const unsigned char * str = chars();
     if (offset >= this->byteLength)
         return this->charLength;
 
@@ -1281,15 +2114,15 @@ uint32_t StringPrim::byteOffsetToUTF16Index (unsigned offset) const
     const unsigned char * lpos;
     const unsigned char * pos;
 
-    lpos = this->_str + this->lastPos;
-    pos = this->_str + offset;
+    lpos = str + this->lastPos;
+    pos = str + offset;
     lindex = this->lastIndex;
 
     if (pos == lpos) {
         // nothing
     } else {
         if (pos < lpos) {
-            lpos = this->_str;
+            lpos = str;
             lindex = 0;
         }
         while (lpos < pos) {
@@ -1298,7 +2131,7 @@ uint32_t StringPrim::byteOffsetToUTF16Index (unsigned offset) const
             lindex += (cpLen >> 2) + 1; // same as cpLen < 4 ? 1 : 2
         }
 
-        this->lastPos = lpos - this->_str;
+        this->lastPos = lpos - str;
         this->lastIndex = lindex;
     }
 
@@ -1394,10 +2227,15 @@ TaggedValue StringPrim::substring (StackFrame * caller, uint32_t from, uint32_t
     }
 
     unsigned length = (toPos - fromPos) + fromAdj + toAdj;
+    unsigned fromOffset = fromPos - chars();
+
+    if (!fromAdj && !toAdj && shouldSlice(length))
+        return makeStringValue(makeSlice(caller, this, fromOffset, length, to - from));
 
     StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":StringPrim::substring()", __LINE__);
     StringPrim * str;
     frame.locals[0] = makeStringValue(str = StringPrim::makeEmpty(&frame, length));
+    fromPos = chars() + fromOffset;
 
     if (fromAdj)
         utf8Encode(str->_str, UNICODE_REPLACEMENT_CHARACTER);
@@ -1421,10 +2259,10 @@ TaggedValue StringPrim::byteSubstring (StackFrame * caller, uint32_t from, uint3
         return makeStringValue(JS_GET_RUNTIME(caller)->permStrEmpty);
 
     // The whole string?
-    if (JS_UNLIKELY(from == 0 && to == this->charLength))
+    if (JS_UNLIKELY(from == 0 && to == this->byteLength))
         return makeStringValue(this);
 
-    const unsigned char * fromPos = this->_str + from;
+    const unsigned char * fromPos = chars() + from;
 
     // only a single character requested?
     if (JS_UNLIKELY(to == from + 1 && *fromPos < Runtime::CACHED_CHARS))
@@ -1432,10 +2270,13 @@ TaggedValue StringPrim::byteSubstring (StackFrame * caller, uint32_t from, uint3
 
     unsigned length = to - from;
 
+    if (shouldSlice(length))
+        return makeStringValue(makeSlice(caller, this, from, length, lengthInUTF16Units(fromPos, fromPos + length)));
+
     StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":StringPrim::byteSubstring()", __LINE__);
     StringPrim * str;
     frame.locals[0] = makeStringValue(str = StringPrim::makeEmpty(&frame, length));
-    memcpy(str->_str, fromPos, length);
+    memcpy(str->_str, chars() + from, length);
     str->init();
     return makeStringValue(str);
 }
@@ -1443,15 +2284,7 @@ TaggedValue StringPrim::byteSubstring (StackFrame * caller, uint32_t from, uint3
 
 unsigned StringPrim::lengthInUTF16Units (const unsigned char * from, const unsigned char * to)
 {
-    unsigned length = 0;
-
-    while (from < to) {
-        unsigned cpLen = utf8CodePointLength(*from);
-        from += cpLen;
-        length += (cpLen >> 2) + 1; // same as cpLen < 4 ? 1 : 2
-    }
-
-    return length;
+    return utf8LengthInUTF16Units(from, to);
 }
 
 bool Box::mark (IMark * marker, unsigned markBit) const
@@ -1464,21 +2297,6 @@ TaggedValue Box::defaultValue (StackFrame *, ValueTag)
     return this->value;
 }
 
-InternalClass Number::getInternalClass () const
-{
-    return ICLS_NUMBER;
-}
-
-InternalClass Boolean::getInternalClass () const
-{
-    return ICLS_BOOLEAN;
-}
-
-InternalClass String::getInternalClass () const
-{
-    return ICLS_STRING;
-}
-
 bool String::mark (IMark * marker, unsigned markBit) const
 {
     return super::mark(marker, markBit) && markValue(marker, markBit, this->value);
@@ -1514,11 +2332,6 @@ bool String::deleteAtIndex (uint32_t index)
     return false;
 }
 
-InternalClass Error::getInternalClass () const
-{
-    return ICLS_ERROR;
-}
-
 bool StackFrame::mark (IMark * marker, unsigned markBit) const
 {
     if (!markMemory(marker, markBit, escaped))
@@ -1599,7 +2412,7 @@ TaggedValue functionApply (StackFrame * caller, Env *, unsigned argc, const Tagg
     } else {
         // Slow path: must allocate the arguments slots in heap
         ArrayBase * argSlots = newInit<ArrayBase>(&frame, &frame.locals[1], JS_GET_RUNTIME(&frame)->arrayPrototype);
-        argSlots->setLength(n+1);
+        argSlots->elems.resize(n+1);
         argSlots->elems[0] = frame.locals[0]; // thisArg
         for ( uint32_t index = 0; index < n; ++index )
             argSlots->elems[index+1] = argArray.raw.oval->getComputed(&frame, makeNumberValue(index));
@@ -2011,9 +2824,18 @@ static void arrayInit (Array * array, unsigned argc, const TaggedValue * argv)
             array->setElem(i - 1, argv[i]);
     }
 }
+template<>
+Object * PrototypeCreator<Object,Array>::createDescendant (StackFrame * caller, AllocSite *)
+{
+    Array * array = newInit<Array>(caller, this);
+    array->numbersOnly = true;
+    return array;
+}
+
 TaggedValue arrayFunction (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
 {
     Array * array = newInit<Array>(caller, JS_GET_RUNTIME(caller)->arrayPrototype);
+    array->numbersOnly = true;
     arrayInit(array, argc, argv);
     return makeObjectValue(array);
 }
@@ -2173,161 +2995,846 @@ public:
         obj(obj), compareFn(compareFn)
     {}
 
+    /** The compare function could have shrunk the array or made it sparse */
+    bool valid (uint32_t a, uint32_t b) const
+    {
+        return JS_LIKELY(a < obj->elems.size() && b < obj->elems.size());
+    }
+
     virtual void swap (StackFrame * caller, uint32_t a, uint32_t b)
     {
+        if (!valid(a, b))
+            return;
+        TaggedValue * pa = &obj->elems[a];
+        TaggedValue * pb = &obj->elems[b];
+
+        TaggedValue tmp = *pa;
+        *pa = *pb;
+        *pb = tmp;
+    }
+
+    virtual bool less (StackFrame * caller, uint32_t a, uint32_t b)
+    {
+        if (!valid(a, b))
+            return false;
         TaggedValue * pa = &obj->elems[a];
         TaggedValue * pb = &obj->elems[b];
 
-        TaggedValue tmp = *pa;
-        *pa = *pb;
-        *pb = tmp;
+        // The compare function may have stored other values, so the kind is checked every time
+        if (!obj->isPackedNumbers()) {
+            if (pa->tag == VT_ARRAY_HOLE) {
+                return false;
+            } else {
+                if (pb->tag == VT_ARRAY_HOLE)
+                    return true;
+            }
+
+            if (pa->tag == VT_UNDEFINED) {
+                return false;
+            } else {
+                if (pb->tag == VT_UNDEFINED)
+                    return true;
+            }
+        }
+
+        StackFrameN<0,4,0> frame(caller, NULL, __FILE__ ":ArraySortCB::less()", __LINE__);
+
+        if (compareFn) {
+            frame.locals[1] = *pa;
+            frame.locals[2] = *pb;
+            frame.locals[3] = compareFn->call(&frame, 3, &frame.locals[0]);
+            return js::toNumber(&frame, frame.locals[3]) < 0;
+        } else {
+            frame.locals[1] = toString(&frame, *pa);
+            frame.locals[2] = toString(&frame, *pb);
+
+            return frame.locals[1].raw.sval != frame.locals[2].raw.sval &&
+                   ::strcmp(frame.locals[1].raw.sval->getStr(), frame.locals[2].raw.sval->getStr()) < 0;
+        }
+    }
+};
+
+class ArraySortCBAlg
+{
+    ArrayBase * obj;
+    Function * compareFn;
+public:
+    ArraySortCBAlg (ArrayBase * obj, Function * compareFn) :
+        obj(obj), compareFn(compareFn)
+    {}
+
+    void swap (StackFrame * caller, TaggedValue * pa, TaggedValue * pb) const
+    {
+        TaggedValue tmp = *pa;
+        *pa = *pb;
+        *pb = tmp;
+    }
+
+    bool less (StackFrame * caller, TaggedValue * pa, TaggedValue * pb) const
+    {
+        // The compare function may have stored other values, so the kind is checked every time
+        if (!obj->isPackedNumbers()) {
+            if (pa->tag == VT_ARRAY_HOLE) {
+                return false;
+            } else {
+                if (pb->tag == VT_ARRAY_HOLE)
+                    return true;
+            }
+
+            if (pa->tag == VT_UNDEFINED) {
+                return false;
+            } else {
+                if (pb->tag == VT_UNDEFINED)
+                    return true;
+            }
+        }
+
+        StackFrameN<0,4,0> frame(caller, NULL, __FILE__ ":ArraySortCB::less()", __LINE__);
+
+        if (compareFn) {
+            frame.locals[1] = *pa;
+            frame.locals[2] = *pb;
+            frame.locals[3] = compareFn->call(&frame, 3, &frame.locals[0]);
+            return js::toNumber(&frame, frame.locals[3]) < 0;
+        } else {
+            frame.locals[1] = toString(&frame, *pa);
+            frame.locals[2] = toString(&frame, *pb);
+
+            return frame.locals[1].raw.sval != frame.locals[2].raw.sval &&
+                   ::strcmp(frame.locals[1].raw.sval->getStr(), frame.locals[2].raw.sval->getStr()) < 0;
+        }
+    }
+};
+
+TaggedValue arraySort (StackFrame * caller, Env * env, unsigned argc, const TaggedValue * argv)
+{
+    StackFrameN<0,3,0> frame(caller, NULL, __FILE__ ":arraySort()", __LINE__);
+    Function * compareFn;
+
+    if (argc > 1) {
+        if (!(compareFn = isFunction(argv[1])))
+            throwTypeError(&frame, "'comparefn' is not callable");
+    } else {
+        compareFn = NULL;
+    }
+
+    // obj = toObject(this)
+    frame.locals[0] = JS_LIKELY(isValueTagObject(argv[0].tag)) ? *argv : js::makeObjectValue(toObject(&frame, argv[0]));
+    Object * obj = frame.locals[0].raw.oval;
+    uint32_t length;
+    IndexedObject * io;
+    ArrayBase * array = NULL;
+
+    if (JS_LIKELY(obj->hasClassBits(CLS_INDEXED) && (obj->flags & OF_INDEX_PROPERTIES) == 0)) {
+        io = static_cast<IndexedObject *>(obj);
+        length = io->getIndexedLength();
+        // Also check if it is an array for even better performance
+        if (obj->getInternalClass() == ICLS_ARRAY)
+            array = static_cast<Array *>(io);
+    } else {
+        // A very unlikely and very slow case. So, we copy it into an array
+        length = js::toUint32(&frame, js::get(caller, frame.locals[0], JS_GET_RUNTIME(&frame)->permStrLength));
+        if (!length)
+            return frame.locals[0];
+
+        io = array = newInit<Array>(&frame, &frame.locals[1], JS_GET_RUNTIME(&frame)->arrayPrototype);
+        array->setLength(length);
+        for ( uint32_t i = 0; i < length; ++i ) {
+            TaggedValue ip = makeNumberValue(i);
+            if (obj->hasComputed(&frame, ip))
+                array->setElem(i, obj->getComputed(&frame, ip));
+        }
+    }
+
+    if (array && array->isSparse()) {
+        // The holes sort after everything else, so only the existing elements need to be sorted. They are
+        // moved into a dense temporary array and then stored back at the beginning.
+        Array * packed = newInit<Array>(&frame, &frame.locals[2], JS_GET_RUNTIME(&frame)->arrayPrototype);
+        for ( uint32_t i = array->nextIndex(0); i < length; i = array->nextIndex(i + 1) )
+            packed->elems.push_back(array->getElem(i));
+
+        ArraySortCB cb(packed, compareFn);
+        quickSort(&frame, &cb, 0, packed->getLength());
+
+        array->setLength(0);
+        array->setLength(length);
+        for ( uint32_t i = 0, e = packed->getLength(); i != e; ++i )
+            array->setElem(i, packed->elems[i]);
+    } else if (array) {
+        ArraySortCB cb(array, compareFn);
+        quickSort(&frame, &cb, 0, length);
+    } else {
+        IndexedObjectSortCB cb(io, compareFn);
+        quickSort(&frame, &cb, 0, length);
+    }
+
+    if (io != obj) { // Copy back the temporary array we created
+        assert(array);
+        for ( uint32_t i = 0; i < length; ++i ) {
+            if (array->hasElem(i))
+                obj->putComputed(&frame, makeNumberValue(i), array->getElem(i));
+            else
+                obj->deleteComputed(&frame, makeNumberValue(i));
+        }
+    }
+
+    return frame.locals[0];
+}
+
+/**
+ * Convert 'this' of an Array.prototype method to an object, keeping it in *holder.
+ */
+static Object * arrayThis (StackFrame * caller, TaggedValue thisp, TaggedValue * holder)
+{
+    *holder = JS_LIKELY(isValueTagObject(thisp.tag)) ? thisp : makeObjectValue(toObject(caller, thisp));
+    return holder->raw.oval;
+}
+
+/**
+ * Return the object as an array, if the mutating Array.prototype methods can operate directly on its elements:
+ * it must be a real array without index-like properties, which is not frozen, sealed or non-extensible.
+ */
+static ArrayBase * mutableArray (Object * obj)
+{
+    if (JS_LIKELY(obj->getInternalClass() == ICLS_ARRAY) &&
+        JS_LIKELY(!(obj->flags & (OF_NOEXTEND | OF_NOCONFIG | OF_NOWRITE | OF_INDEX_PROPERTIES))))
+    {
+        return static_cast<ArrayBase *>(obj);
+    }
+    return NULL;
+}
+
+/**
+ * Return the object as an ArrayBase, if its elements in [0, length) can be read directly.
+ */
+static const ArrayBase * readableArray (Object * obj, uint32_t length)
+{
+    if (JS_LIKELY(obj->hasClassBits(CLS_ARRAY_BASE)) && JS_LIKELY(!(obj->flags & OF_INDEX_PROPERTIES))) {
+        const ArrayBase * ab = static_cast<const ArrayBase *>(obj);
+        if (JS_LIKELY(ab->getLength() >= length))
+            return ab;
+    }
+    return NULL;
+}
+
+static uint32_t genericLength (StackFrame * caller, Object * obj)
+{
+    return toUint32(caller, obj->get(caller, JS_GET_RUNTIME(caller)->permStrLength));
+}
+
+static void genericSetLength (StackFrame * caller, Object * obj, double length)
+{
+    obj->put(caller, JS_GET_RUNTIME(caller)->permStrLength, makeNumberValue(length));
+}
+
+/**
+ * Convert a relative index argument of slice() and splice() to [0, length]. The result is 0 for NaN.
+ */
+static uint32_t relativeIndex (StackFrame * caller, TaggedValue v, uint32_t length)
+{
+    double d = toInteger(caller, v);
+    if (d < 0)
+        return d + length > 0 ? (uint32_t)(d + length) : 0;
+    else
+        return d < length ? (uint32_t)d : length;
+}
+
+/** Create an empty array, like the literal [] does */
+static ArrayBase * newArrayLiteral (StackFrame * caller, TaggedValue * holder)
+{
+    Object * a = JS_GET_RUNTIME(caller)->arrayPrototype->createDescendant(caller);
+    *holder = makeObjectValue(a);
+    return static_cast<ArrayBase *>(a);
+}
+
+/**
+ * Copy the elements [srcFrom, srcTo) of an array-like object to dest, which must have sufficient length and
+ * be filled with holes in the destination range.
+ */
+static void copyToArray (
+    StackFrame * caller, ArrayBase * dest, uint32_t destIndex, Object * src, uint32_t srcFrom, uint32_t srcTo
+)
+{
+    if (const ArrayBase * ab = readableArray(src, srcTo)) {
+        dest->copyElems(destIndex, ab, srcFrom, srcTo);
+    } else {
+        StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":copyToArray()", __LINE__);
+        for ( uint32_t i = srcFrom; i < srcTo; ++i, ++destIndex ) {
+            TaggedValue ip = makeNumberValue(i);
+            if (src->hasComputed(&frame, ip)) {
+                frame.locals[0] = src->getComputed(&frame, ip);
+                dest->setElem(destIndex, frame.locals[0]);
+            }
+        }
+    }
+}
+
+/**
+ * Move the elements [srcFrom, srcTo) of a generic object to destIndex, deleting the missing ones.
+ */
+static void genericMoveElements (StackFrame * caller, Object * obj, uint32_t destIndex, uint32_t srcFrom, uint32_t srcTo)
+{
+    StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":genericMoveElements()", __LINE__);
+    uint32_t count = srcTo - srcFrom;
+
+    for ( uint32_t k = 0; k < count; ++k ) {
+        // Copy in the reverse direction when moving to the right
+        uint32_t ofs = destIndex <= srcFrom ? k : count - 1 - k;
+        TaggedValue from = makeNumberValue(srcFrom + ofs);
+        TaggedValue to = makeNumberValue(destIndex + ofs);
+        if (obj->hasComputed(&frame, from)) {
+            frame.locals[0] = obj->getComputed(&frame, from);
+            obj->putComputed(&frame, to, frame.locals[0]);
+        } else {
+            obj->deleteComputed(&frame, to);
+        }
+    }
+}
+
+TaggedValue arrayPush (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":arrayPush()", __LINE__);
+    Object * obj = arrayThis(&frame, argv[0], &frame.locals[0]);
+    unsigned count = argc - 1;
+
+    if (ArrayBase * array = mutableArray(obj)) {
+        uint32_t len = array->getLength();
+        if (JS_LIKELY(len + (uint64_t)count <= UINT32_MAX)) {
+            array->append(argv + 1, count);
+            return makeNumberValue(len + count);
+        }
+    }
+
+    double n = genericLength(&frame, obj);
+    for ( unsigned i = 0; i != count; ++i )
+        obj->putComputed(&frame, makeNumberValue(n++), argv[i + 1]);
+    genericSetLength(&frame, obj, n);
+    return makeNumberValue(n);
+}
+
+TaggedValue arrayPop (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    StackFrameN<0,2,0> frame(caller, NULL, __FILE__ ":arrayPop()", __LINE__);
+    Object * obj = arrayThis(&frame, argv[0], &frame.locals[0]);
+
+    if (ArrayBase * array = mutableArray(obj)) {
+        uint32_t len = array->getLength();
+        if (len == 0)
+            return JS_UNDEFINED_VALUE;
+        TaggedValue element = array->getElem(len - 1);
+        array->setLength(len - 1);
+        return element;
+    }
+
+    uint32_t len = genericLength(&frame, obj);
+    if (len == 0) {
+        genericSetLength(&frame, obj, 0);
+        return JS_UNDEFINED_VALUE;
+    }
+    TaggedValue index = makeNumberValue(len - 1);
+    frame.locals[1] = obj->getComputed(&frame, index);
+    obj->deleteComputed(&frame, index);
+    genericSetLength(&frame, obj, len - 1);
+    return frame.locals[1];
+}
+
+TaggedValue arrayShift (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    StackFrameN<0,2,0> frame(caller, NULL, __FILE__ ":arrayShift()", __LINE__);
+    Object * obj = arrayThis(&frame, argv[0], &frame.locals[0]);
+
+    if (ArrayBase * array = mutableArray(obj)) {
+        uint32_t len = array->getLength();
+        if (len == 0)
+            return JS_UNDEFINED_VALUE;
+        TaggedValue element = array->getElem(0);
+        array->removeFront(1);
+        return element;
+    }
+
+    uint32_t len = genericLength(&frame, obj);
+    if (len == 0) {
+        genericSetLength(&frame, obj, 0);
+        return JS_UNDEFINED_VALUE;
+    }
+    frame.locals[1] = obj->getComputed(&frame, makeNumberValue(0));
+    genericMoveElements(&frame, obj, 0, 1, len);
+    obj->deleteComputed(&frame, makeNumberValue(len - 1));
+    genericSetLength(&frame, obj, len - 1);
+    return frame.locals[1];
+}
+
+TaggedValue arrayUnshift (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":arrayUnshift()", __LINE__);
+    Object * obj = arrayThis(&frame, argv[0], &frame.locals[0]);
+    unsigned count = argc - 1;
+
+    if (ArrayBase * array = mutableArray(obj)) {
+        uint32_t len = array->getLength();
+        if (JS_LIKELY(len + (uint64_t)count <= UINT32_MAX)) {
+            if (count != 0) {
+                array->setLength(len + count);
+                array->copyElems(count, array, 0, len);
+                for ( unsigned i = 0; i != count; ++i )
+                    array->setElem(i, argv[i + 1]);
+            }
+            return makeNumberValue(len + count);
+        }
+    }
+
+    uint32_t len = genericLength(&frame, obj);
+    if (count != 0) {
+        if (len + (uint64_t)count > UINT32_MAX)
+            throwTypeError(&frame, "Invalid array length");
+        genericMoveElements(&frame, obj, count, 0, len);
+        for ( unsigned i = 0; i != count; ++i )
+            obj->putComputed(&frame, makeNumberValue(i), argv[i + 1]);
+    }
+    genericSetLength(&frame, obj, (double)len + count);
+    return makeNumberValue((double)len + count);
+}
+
+TaggedValue arraySlice (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    StackFrameN<0,2,0> frame(caller, NULL, __FILE__ ":arraySlice()", __LINE__);
+    Object * obj = arrayThis(&frame, argv[0], &frame.locals[0]);
+
+    uint32_t len = obj->getInternalClass() == ICLS_ARRAY ?
+        static_cast<ArrayBase *>(obj)->getLength() : genericLength(&frame, obj);
+    uint32_t k = argc > 1 ? relativeIndex(&frame, argv[1], len) : 0;
+    uint32_t final = argc > 2 && argv[2].tag != VT_UNDEFINED ? relativeIndex(&frame, argv[2], len) : len;
+
+    ArrayBase * a = newArrayLiteral(&frame, &frame.locals[1]);
+    if (k < final) {
+        a->setLength(final - k);
+        copyToArray(&frame, a, 0, obj, k, final);
+    }
+    return frame.locals[1];
+}
+
+TaggedValue arraySplice (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    StackFrameN<0,3,0> frame(caller, NULL, __FILE__ ":arraySplice()", __LINE__);
+    Object * obj = arrayThis(&frame, argv[0], &frame.locals[0]);
+    ArrayBase * array = mutableArray(obj);
+
+    uint32_t len = array ? array->getLength() : genericLength(&frame, obj);
+    uint32_t start = argc > 1 ? relativeIndex(&frame, argv[1], len) : 0;
+    uint32_t deleteCount = 0;
+    if (argc > 2) {
+        double d = toInteger(&frame, argv[2]);
+        if (d > 0)
+            deleteCount = d < len - start ? (uint32_t)d : len - start;
+    }
+    // The conversions could have changed the array
+    if (array && (array != mutableArray(obj) || array->getLength() != len))
+        array = NULL;
+    unsigned itemCount = argc > 3 ? argc - 3 : 0;
+    const TaggedValue * items = argv + 3;
+
+    if ((uint64_t)len - deleteCount + itemCount > UINT32_MAX)
+        throwTypeError(&frame, "Invalid array length");
+    uint32_t newLen = len - deleteCount + itemCount;
+
+    ArrayBase * a = newArrayLiteral(&frame, &frame.locals[1]);
+    if (deleteCount != 0) {
+        a->setLength(deleteCount);
+        copyToArray(&frame, a, 0, obj, start, start + deleteCount);
+    }
+
+    if (array) {
+        if (start == 0 && itemCount < deleteCount) {
+            array->removeFront(deleteCount - itemCount);
+        } else if (itemCount != deleteCount) {
+            if (itemCount > deleteCount)
+                array->setLength(newLen);
+            array->copyElems(start + itemCount, array, start + deleteCount, len);
+            if (itemCount < deleteCount)
+                array->setLength(newLen);
+        }
+        for ( unsigned i = 0; i != itemCount; ++i )
+            array->setElem(start + i, items[i]);
+    } else {
+        if (itemCount != deleteCount) {
+            genericMoveElements(&frame, obj, start + itemCount, start + deleteCount, len);
+            // Delete the elements left behind when moving to the left
+            for ( uint32_t k = len; k > newLen; --k )
+                obj->deleteComputed(&frame, makeNumberValue(k - 1));
+        }
+        for ( unsigned i = 0; i != itemCount; ++i )
+            obj->putComputed(&frame, makeNumberValue(start + i), items[i]);
+        genericSetLength(&frame, obj, newLen);
+    }
+
+    return frame.locals[1];
+}
+
+/** concat() spreads the elements of real arrays and appends everything else as a single element */
+static ArrayBase * concatSpreadable (TaggedValue item)
+{
+    if (isValueTagObject(item.tag) && item.raw.oval->getInternalClass() == ICLS_ARRAY)
+        return static_cast<ArrayBase *>(item.raw.oval.get());
+    return NULL;
+}
+
+TaggedValue arrayConcat (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    StackFrameN<0,2,0> frame(caller, NULL, __FILE__ ":arrayConcat()", __LINE__);
+    arrayThis(&frame, argv[0], &frame.locals[0]);
+
+    // The items are the object followed by the arguments. Size the result array first.
+    uint64_t n = 0;
+    for ( unsigned i = 0; i != argc; ++i ) {
+        ArrayBase * array = concatSpreadable(i == 0 ? frame.locals[0] : argv[i]);
+        n += array ? array->getLength() : 1;
+    }
+    if (n > UINT32_MAX)
+        throwTypeError(&frame, "Invalid array length");
+
+    ArrayBase * a = newArrayLiteral(&frame, &frame.locals[1]);
+    a->setLength((uint32_t)n);
+
+    uint32_t destIndex = 0;
+    for ( unsigned i = 0; i != argc; ++i ) {
+        TaggedValue item = i == 0 ? frame.locals[0] : argv[i];
+        if (ArrayBase * array = concatSpreadable(item)) {
+            uint32_t len = array->getLength();
+            copyToArray(&frame, a, destIndex, array, 0, len);
+            destIndex += len;
+        } else {
+            a->setElem(destIndex++, item);
+        }
+    }
+
+    return frame.locals[1];
+}
+
+/** An upper bound of the length of a primitive value converted to string by join() */
+static size_t joinedLength (TaggedValue v)
+{
+    switch (v.tag) {
+        case VT_STRINGPRIM: return v.raw.sval->byteLength;
+        case VT_NUMBER:     return v.isInt32() ? 11 : 32;
+        case VT_BOOLEAN:    return 5;
+        default:            return 0; // undefined, null and holes are empty
+    }
+}
+
+/** Append a primitive value converted to string, in space reserved according to joinedLength() */
+static void appendJoined (StringBuilder & sb, TaggedValue v)
+{
+    char buf[32];
+    const char * str;
+
+    switch (v.tag) {
+        case VT_STRINGPRIM:
+            sb.addUnsafe(v.raw.sval->chars(), v.raw.sval->byteLength);
+            return;
+        case VT_NUMBER:
+            if (v.isInt32()) {
+                int32_t i = v.raw.ival;
+                uint32_t n = i < 0 ? 0u - (uint32_t)i : (uint32_t)i;
+                char * p = buf + sizeof(buf);
+                do
+                    *--p = (char)('0' + n % 10);
+                while ((n /= 10) != 0);
+                if (i < 0)
+                    *--p = '-';
+                sb.addUnsafe((const unsigned char *)p, buf + sizeof(buf) - p);
+                return;
+            } else {
+                double d = v.raw.nval;
+                if (isnan(d))
+                    str = "NaN";
+                else if (!isfinite(d))
+                    str = d < 0 ? "-Infinity" : "Infinity";
+                else
+                    str = g_fmt(buf, d);
+            }
+            break;
+        case VT_BOOLEAN:
+            str = v.raw.bval ? "true" : "false";
+            break;
+        default:
+            return;
+    }
+    sb.addUnsafe((const unsigned char *)str, strlen(str));
+}
+
+TaggedValue arrayJoin (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    StackFrameN<0,3,0> frame(caller, NULL, __FILE__ ":arrayJoin()", __LINE__);
+    Object * obj = arrayThis(&frame, argv[0], &frame.locals[0]);
+    Runtime * r = JS_GET_RUNTIME(&frame);
+
+    uint32_t len = obj->getInternalClass() == ICLS_ARRAY ?
+        static_cast<ArrayBase *>(obj)->getLength() : genericLength(&frame, obj);
+    if (len == 0)
+        return makeStringValue(r->permStrEmpty);
+
+    bool customSep = argc > 1 && argv[1].tag != VT_UNDEFINED;
+    size_t sepLen = 1;
+    if (customSep) {
+        frame.locals[1] = toString(&frame, argv[1]);
+        sepLen = frame.locals[1].raw.sval->byteLength;
     }
 
-    virtual bool less (StackFrame * caller, uint32_t a, uint32_t b)
-    {
-        TaggedValue * pa = &obj->elems[a];
-        TaggedValue * pb = &obj->elems[b];
+    // Convert the elements to primitives and add up their lengths. Converting an object can run arbitrary
+    // code, as can reading a generic object, so in that case the primitives are collected in 'prims', as
+    // pairs of index and value. Only values which don't convert to an empty string are collected, and only
+    // the present elements of an array are visited, so a sparse array never needs a buffer of its length.
+    // No code may run while the StringBuilder exists, since a thrown exception would leak it.
+    const ArrayBase * array = readableArray(obj, len);
+    ArrayBase * prims = NULL;
+    size_t total = sepLen * (len - 1);
+
+    for ( uint32_t i = array ? array->nextIndex(0) : 0; i < len; i = array ? array->nextIndex(i + 1) : i + 1 ) {
+        TaggedValue v = array ? array->getElem(i) : obj->getComputed(&frame, makeNumberValue(i));
+        if (!prims && (!array || isValueTagObject(v.tag))) {
+            prims = newInit<ArrayBase>(&frame, &frame.locals[2], r->arrayPrototype);
+            // Collect the preceding elements, which were all primitives
+            for ( uint32_t j = array ? array->nextIndex(0) : i; j < i; j = array->nextIndex(j + 1) ) {
+                TaggedValue pv = array->getElem(j);
+                if (joinedLength(pv)) {
+                    prims->elems.push_back(makeNumberValue(j));
+                    prims->elems.push_back(pv);
+                }
+            }
+        }
+        if (isValueTagObject(v.tag))
+            v = toString(&frame, v);
+        if (size_t vlen = joinedLength(v)) {
+            if (prims) {
+                prims->elems.push_back(makeNumberValue(i));
+                prims->elems.push_back(v);
+            }
+            total += vlen;
+        }
+    }
 
-        if (pa->tag == VT_ARRAY_HOLE) {
-            return false;
-        } else {
-            if (pb->tag == VT_ARRAY_HOLE)
-                return true;
+    // The characters of a slice may move during a GC, so they are fetched only after the last allocation
+    const unsigned char * sep = customSep ? frame.locals[1].raw.sval->chars() : (const unsigned char *)",";
+    StringBuilder sb(&frame, total + 1);
+    if (prims) {
+        uint32_t pos = 0;
+        for ( uint32_t k = 0, e = prims->elems.size(); k != e; k += 2 ) {
+            for ( uint32_t index = (uint32_t)prims->elems[k].raw.nval; pos < index; ++pos )
+                sb.addUnsafe(sep, sepLen);
+            appendJoined(sb, prims->elems[k + 1]);
+        }
+        for ( ; pos < len - 1; ++pos )
+            sb.addUnsafe(sep, sepLen);
+    } else {
+        uint32_t pos = 0;
+        for ( uint32_t i = array->nextIndex(0); i < len; i = array->nextIndex(i + 1) ) {
+            for ( ; pos < i; ++pos )
+                sb.addUnsafe(sep, sepLen);
+            appendJoined(sb, array->getElem(i));
         }
+        for ( ; pos < len - 1; ++pos )
+            sb.addUnsafe(sep, sepLen);
+    }
+    return makeStringValue(sb.toStringPrim(&frame));
+}
 
-        if (pa->tag == VT_UNDEFINED) {
+/**
+ * Read element 'k' of an array-like object for the iteration methods, directly if it is an ArrayBase.
+ * The callback could have defined index-like properties, so that is checked every time.
+ * @return false if the element doesn't exist
+ */
+static inline bool iterElement (StackFrame * caller, Object * obj, uint32_t k, TaggedValue * result)
+{
+    if (JS_LIKELY(obj->hasClassBits(CLS_ARRAY_BASE)) && JS_LIKELY(!(obj->flags & OF_INDEX_PROPERTIES))) {
+        const ArrayBase * array = static_cast<const ArrayBase *>(obj);
+        if (!array->hasElem(k))
             return false;
-        } else {
-            if (pb->tag == VT_UNDEFINED)
-                return true;
-        }
+        *result = array->getElem(k);
+        return true;
+    }
 
-        StackFrameN<0,4,0> frame(caller, NULL, __FILE__ ":ArraySortCB::less()", __LINE__);
+    TaggedValue ik = makeNumberValue(k);
+    if (!obj->hasComputed(caller, ik))
+        return false;
+    *result = obj->getComputed(caller, ik);
+    return true;
+}
 
-        if (compareFn) {
-            frame.locals[1] = *pa;
-            frame.locals[2] = *pb;
-            frame.locals[3] = compareFn->call(&frame, 3, &frame.locals[0]);
-            return js::toNumber(&frame, frame.locals[3]) < 0;
-        } else {
-            frame.locals[1] = toString(&frame, *pa);
-            frame.locals[2] = toString(&frame, *pb);
+/** The length of the object for the iteration methods */
+static uint32_t iterLength (StackFrame * caller, Object * obj)
+{
+    return obj->getInternalClass() == ICLS_ARRAY ?
+        static_cast<ArrayBase *>(obj)->getLength() : genericLength(caller, obj);
+}
 
-            return frame.locals[1].raw.sval != frame.locals[2].raw.sval &&
-                   ::strcmp(frame.locals[1].raw.sval->getStr(), frame.locals[2].raw.sval->getStr()) < 0;
-        }
-    }
-};
+static Function * iterCallback (StackFrame * caller, unsigned argc, const TaggedValue * argv)
+{
+    Function * fn;
+    if (argc < 2 || !(fn = isFunction(argv[1])))
+        throwTypeError(caller, "callback is not a function");
+    return fn;
+}
 
-class ArraySortCBAlg
+/**
+ * The state shared by forEach(), map(), filter(), some() and every(). The arguments of the callback are
+ * kept in one block of locals, which is reused for every element.
+ */
+struct ArrayIteration
 {
-    ArrayBase * obj;
-    Function * compareFn;
-public:
-    ArraySortCBAlg (ArrayBase * obj, Function * compareFn) :
-        obj(obj), compareFn(compareFn)
-    {}
+    enum { ARG_THIS, ARG_VALUE, ARG_INDEX, ARG_OBJECT, ARG_COUNT };
 
-    void swap (StackFrame * caller, TaggedValue * pa, TaggedValue * pb) const
+    StackFrameN<0,ARG_COUNT+1,0> frame;
+    Object * obj;
+    uint32_t len;
+    Function * fn;
+
+    ArrayIteration (StackFrame * caller, unsigned argc, const TaggedValue * argv, const char * name) :
+        frame(caller, NULL, name, __LINE__)
     {
-        TaggedValue tmp = *pa;
-        *pa = *pb;
-        *pb = tmp;
+        obj = arrayThis(&frame, argv[0], &frame.locals[ARG_OBJECT]);
+        len = iterLength(&frame, obj);
+        fn = iterCallback(&frame, argc, argv);
+        frame.locals[ARG_THIS] = argc > 2 ? argv[2] : JS_UNDEFINED_VALUE;
     }
 
-    bool less (StackFrame * caller, TaggedValue * pa, TaggedValue * pb) const
+    /** Load element 'k' into the arguments block */
+    bool load (uint32_t k)
     {
-        if (pa->tag == VT_ARRAY_HOLE) {
-            return false;
-        } else {
-            if (pb->tag == VT_ARRAY_HOLE)
-                return true;
-        }
-
-        if (pa->tag == VT_UNDEFINED) {
+        if (!iterElement(&frame, obj, k, &frame.locals[ARG_VALUE]))
             return false;
-        } else {
-            if (pb->tag == VT_UNDEFINED)
-                return true;
-        }
+        frame.locals[ARG_INDEX] = makeNumberValue(k);
+        return true;
+    }
 
-        StackFrameN<0,4,0> frame(caller, NULL, __FILE__ ":ArraySortCB::less()", __LINE__);
+    TaggedValue call ()
+    {
+        return fn->call(&frame, ARG_COUNT, &frame.locals[0]);
+    }
 
-        if (compareFn) {
-            frame.locals[1] = *pa;
-            frame.locals[2] = *pb;
-            frame.locals[3] = compareFn->call(&frame, 3, &frame.locals[0]);
-            return js::toNumber(&frame, frame.locals[3]) < 0;
-        } else {
-            frame.locals[1] = toString(&frame, *pa);
-            frame.locals[2] = toString(&frame, *pb);
+    const TaggedValue & value () const
+    {
+        return frame.locals[ARG_VALUE];
+    }
 
-            return frame.locals[1].raw.sval != frame.locals[2].raw.sval &&
-                   ::strcmp(frame.locals[1].raw.sval->getStr(), frame.locals[2].raw.sval->getStr()) < 0;
-        }
+    /** A slot for the result, which is kept alive */
+    TaggedValue & result ()
+    {
+        return frame.locals[ARG_COUNT];
     }
 };
 
-TaggedValue arraySort (StackFrame * caller, Env * env, unsigned argc, const TaggedValue * argv)
+TaggedValue arrayForEach (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
 {
-    StackFrameN<0,2,0> frame(caller, NULL, __FILE__ ":arraySort()", __LINE__);
-    Function * compareFn;
+    ArrayIteration it(caller, argc, argv, __FILE__ ":arrayForEach()");
+    for ( uint32_t k = 0; k < it.len; ++k )
+        if (it.load(k))
+            it.call();
+    return JS_UNDEFINED_VALUE;
+}
 
-    if (argc > 1) {
-        if (!(compareFn = isFunction(argv[1])))
-            throwTypeError(&frame, "'comparefn' is not callable");
-    } else {
-        compareFn = NULL;
-    }
+TaggedValue arrayMap (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    ArrayIteration it(caller, argc, argv, __FILE__ ":arrayMap()");
+    ArrayBase * a = newArrayLiteral(&it.frame, &it.result());
+    a->setLength(it.len);
+    for ( uint32_t k = 0; k < it.len; ++k )
+        if (it.load(k))
+            a->setElem(k, it.call());
+    return it.result();
+}
 
-    // obj = toObject(this)
-    frame.locals[0] = JS_LIKELY(isValueTagObject(argv[0].tag)) ? *argv : js::makeObjectValue(toObject(&frame, argv[0]));
-    Object * obj = frame.locals[0].raw.oval;
-    uint32_t length;
-    IndexedObject * io;
-    ArrayBase * array = NULL;
+TaggedValue arrayFilter (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    ArrayIteration it(caller, argc, argv, __FILE__ ":arrayFilter()");
+    ArrayBase * a = newArrayLiteral(&it.frame, &it.result());
+    for ( uint32_t k = 0; k < it.len; ++k )
+        if (it.load(k) && toBoolean(it.call()))
+            a->append(&it.value(), 1);
+    return it.result();
+}
 
-    io = dynamic_cast<IndexedObject*>(obj);
-    if (JS_LIKELY(io != NULL && (io->flags & OF_INDEX_PROPERTIES) == 0)) {
-        length = io->getIndexedLength();
-        // Also check if it is an array for even better performance
-        array = dynamic_cast<Array *>(io);
+TaggedValue arraySome (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    ArrayIteration it(caller, argc, argv, __FILE__ ":arraySome()");
+    for ( uint32_t k = 0; k < it.len; ++k )
+        if (it.load(k) && toBoolean(it.call()))
+            return makeBooleanValue(true);
+    return makeBooleanValue(false);
+}
+
+TaggedValue arrayEvery (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    ArrayIteration it(caller, argc, argv, __FILE__ ":arrayEvery()");
+    for ( uint32_t k = 0; k < it.len; ++k )
+        if (it.load(k) && !toBoolean(it.call()))
+            return makeBooleanValue(false);
+    return makeBooleanValue(true);
+}
+
+TaggedValue arrayReduce (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    // The callback arguments are: undefined, accumulator, value, index, object
+    StackFrameN<0,5,0> frame(caller, NULL, __FILE__ ":arrayReduce()", __LINE__);
+    Object * obj = arrayThis(&frame, argv[0], &frame.locals[4]);
+    uint32_t len = iterLength(&frame, obj);
+    Function * fn = iterCallback(&frame, argc, argv);
+
+    uint32_t k = 0;
+    if (argc > 2) {
+        frame.locals[1] = argv[2];
     } else {
-        // A very unlikely and very slow case. So, we copy it into an array
-        length = js::toUint32(&frame, js::get(caller, frame.locals[0], JS_GET_RUNTIME(&frame)->permStrLength));
-        if (!length)
-            return frame.locals[0];
+        for ( ; k < len && !iterElement(&frame, obj, k, &frame.locals[1]); ++k )
+            {}
+        if (k == len)
+            throwTypeError(&frame, "reduce of empty array with no initial value");
+        ++k;
+    }
 
-        io = array = newInit<Array>(&frame, &frame.locals[1], JS_GET_RUNTIME(&frame)->arrayPrototype);
-        array->setLength(length);
-        TaggedValue * p = &array->elems[0];
-        for ( uint32_t i = 0; i < length; ++i, ++p ) {
-            TaggedValue ip = makeNumberValue(i);
-            if (obj->hasComputed(&frame, ip))
-                *p = obj->getComputed(&frame, ip);
+    for ( ; k < len; ++k ) {
+        if (iterElement(&frame, obj, k, &frame.locals[2])) {
+            frame.locals[3] = makeNumberValue(k);
+            frame.locals[1] = fn->call(&frame, 5, &frame.locals[0]);
         }
     }
+    return frame.locals[1];
+}
 
-    if (array) {
-        ArraySortCB cb(array, compareFn);
-        quickSort(&frame, &cb, 0, length);
-    } else {
-        IndexedObjectSortCB cb(io, compareFn);
-        quickSort(&frame, &cb, 0, length);
+TaggedValue arrayIndexOf (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
+{
+    StackFrameN<0,2,0> frame(caller, NULL, __FILE__ ":arrayIndexOf()", __LINE__);
+    Object * obj = arrayThis(&frame, argv[0], &frame.locals[0]);
+    uint32_t len = iterLength(&frame, obj);
+    if (len == 0)
+        return makeInt32Value(-1);
+
+    uint32_t k = 0;
+    if (argc > 2) {
+        double n = toInteger(&frame, argv[2]);
+        if (n >= len)
+            return makeInt32Value(-1);
+        k = n >= 0 ? (uint32_t)n : (n + len > 0 ? (uint32_t)(n + len) : 0);
     }
 
-    if (io != obj) { // Copy back the temporary array we created
-        assert(array);
-        const TaggedValue * p = &array->elems[0];
-        for ( uint32_t i = 0; i < length; ++i, ++p ) {
-            if (p->tag != VT_ARRAY_HOLE)
-                obj->putComputed(&frame, makeNumberValue(i), *p);
-            else
-                obj->deleteComputed(&frame, makeNumberValue(i));
+    TaggedValue search = argc > 1 ? argv[1] : JS_UNDEFINED_VALUE;
+    if (const ArrayBase * array = readableArray(obj, len)) {
+        // Nothing below can run user code
+        if (!array->isSparse()) {
+            const TaggedValue * elems = array->elems.data();
+            for ( ; k < len; ++k )
+                if (elems[k].tag != VT_ARRAY_HOLE && operator_IF_STRICT_EQ(elems[k], search))
+                    return makeNumberValue(k);
+        } else {
+            for ( k = array->nextIndex(k); k < len; k = array->nextIndex(k + 1) )
+                if (operator_IF_STRICT_EQ(array->getElem(k), search))
+                    return makeNumberValue(k);
         }
+        return makeInt32Value(-1);
     }
 
-    return frame.locals[0];
+    for ( ; k < len; ++k )
+        if (iterElement(&frame, obj, k, &frame.locals[1]) && operator_IF_STRICT_EQ(frame.locals[1], search))
+            return makeNumberValue(k);
+    return makeInt32Value(-1);
 }
 
 TaggedValue errorFunction (StackFrame * caller, Env *, unsigned argc, const TaggedValue * argv)
@@ -2395,6 +3902,10 @@ Runtime::Runtime (bool strictMode, int argc, const char ** argv)
     this->argc = argc;
     this->argv = argv;
     env = NULL;
+    protoEpoch = 1;
+    memset(propCache, 0, sizeof(propCache));
+    gcEpoch = 1;
+    descriptorEpoch = 0;
     markBit = 0;
     head.header = 0;
     tail = &head;
@@ -2431,6 +3942,13 @@ Runtime::Runtime (bool strictMode, int argc, const char ** argv)
     permStrToString = internString(&frame, true, "toString");
     permStrValueOf = internString(&frame, true, "valueOf");
     permStrMessage = internString(&frame, true, "message");
+    permStrValue = internString(&frame, true, "value");
+    permStrDone = internString(&frame, true, "done");
+    permStrGet = internString(&frame, true, "get");
+    permStrSet = internString(&frame, true, "set");
+    permStrWritable = internString(&frame, true, "writable");
+    permStrEnumerable = internString(&frame, true, "enumerable");
+    permStrConfigurable = internString(&frame, true, "configurable");
     {
         char buf[8];
         unsigned length;
@@ -2446,7 +3964,7 @@ Runtime::Runtime (bool strictMode, int argc, const char ** argv)
     }
 
     // Global env
-    env = Env::make(&frame, NULL, 40);
+    env = Env::make(&frame, NULL, 45);
 
     // strictThrowerAccessor: the functions will be initialized later when the object system is up
     env->vars[16] = strictThrowerAccessor = makePropertyAccessorValue(new(&frame) PropertyAccessor(NULL, NULL));
@@ -2533,6 +4051,21 @@ Runtime::Runtime (bool strictMode, int argc, const char ** argv)
         arrayConstructor, arrayFunction, "Array", 1, &arrayPrototype, &array
     );
     defineMethod(&frame, arrayPrototype, "sort", 1, arraySort);
+    defineMethod(&frame, arrayPrototype, "push", 1, arrayPush);
+    defineMethod(&frame, arrayPrototype, "pop", 0, arrayPop);
+    defineMethod(&frame, arrayPrototype, "shift", 0, arrayShift);
+    defineMethod(&frame, arrayPrototype, "unshift", 1, arrayUnshift);
+    defineMethod(&frame, arrayPrototype, "slice", 2, arraySlice);
+    defineMethod(&frame, arrayPrototype, "splice", 2, arraySplice);
+    defineMethod(&frame, arrayPrototype, "concat", 1, arrayConcat);
+    defineMethod(&frame, arrayPrototype, "join", 1, arrayJoin);
+    defineMethod(&frame, arrayPrototype, "forEach", 1, arrayForEach);
+    defineMethod(&frame, arrayPrototype, "map", 1, arrayMap);
+    defineMethod(&frame, arrayPrototype, "filter", 1, arrayFilter);
+    defineMethod(&frame, arrayPrototype, "some", 1, arraySome);
+    defineMethod(&frame, arrayPrototype, "every", 1, arrayEvery);
+    defineMethod(&frame, arrayPrototype, "reduce", 1, arrayReduce);
+    defineMethod(&frame, arrayPrototype, "indexOf", 1, arrayIndexOf);
     // Error
     //
     systemConstructor(
@@ -2589,7 +4122,22 @@ Runtime::Runtime (bool strictMode, int argc, const char ** argv)
     _JS_TA_DEF(38, float64, Float64);
 #undef _JS_TA_DEF
 
-    // Next free is env[40]
+    // Collections
+    //
+    systemConstructor(
+        &frame, 40,
+        newInit< PrototypeCreator<Object,Map> >(&frame, &frame.locals[0], objectPrototype),
+        Map::aConstructor, Map::aFunction, "Map", 0, &mapPrototype, &map
+    );
+    systemConstructor(
+        &frame, 42,
+        newInit< PrototypeCreator<Object,Set> >(&frame, &frame.locals[0], objectPrototype),
+        Set::aConstructor, Set::aFunction, "Set", 0, &setPrototype, &set
+    );
+    collectionIteratorPrototype = newInit<Object>(&frame, &env->vars[44], objectPrototype);
+    collectionsInit(&frame);
+
+    // Next free is env[45]
 }
 
 void Runtime::systemConstructor (
@@ -2684,36 +4232,27 @@ bool Runtime::mark (IMark * marker, unsigned markBit)
         markValue(marker, markBit, this->thrownObject);
 }
 
-bool Runtime::less_PasStr::operator() (const PasStr & a, const PasStr & b) const
-{
-    int rel;
-    if (a.first == b.first)
-        return memcmp(a.second, b.second, a.first) < 0;
-    else if (a.first < b.first)
-        return (rel = memcmp(a.second, b.second, a.first)) != 0 ? rel < 0 : true;
-    else
-        return (rel = memcmp(a.second, b.second, b.first)) != 0 ? rel < 0 : false;
-}
-
 const StringPrim * Runtime::findInterned (const StringPrim * str)
 {
     if (JS_UNLIKELY(str->isInterned()))
         return str;
 
-    auto it = permStrings.find(PasStr(str->byteLength, str->_str));
-    return it != permStrings.end() ? it->second : NULL;
+    return permStrings.find(str->chars(), str->byteLength, str->hash());
 }
 
 const StringPrim * Runtime::internString (StackFrame * caller, bool permanent, const char * str, unsigned len)
 {
-    const StringPrim * res;
-    auto it = permStrings.find(PasStr(len, (const unsigned char *)str));
-    if (it == permStrings.end()) {
-        res = StringPrim::makeFromValid(caller, str, len);
-        res->stringFlags |= StringPrim::F_INTERNED | (permanent ? StringPrim::F_PERMANENT : 0);
-        permStrings[PasStr(len, res->_str)] = res;
+    uint32_t hash = StringPrim::hashChars((const unsigned char *)str, len);
+    const StringPrim * res = permStrings.find((const unsigned char *)str, len, hash);
+    if (!res) {
+        StringPrim * s = StringPrim::makeFromValid(caller, str, len);
+        s->hashValue = hash;
+        s->stringFlags |= StringPrim::F_HASH_KNOWN | StringPrim::F_INTERNED |
+            (permanent ? StringPrim::F_PERMANENT : 0);
+        s->computeIndex(); // Interned strings are property names, so we will need it
+        permStrings.insert(s);
+        res = s;
     } else {
-        res = it->second;
         if (JS_UNLIKELY(permanent)) // avoid writing to the existing entry unless we have to
             res->stringFlags |= StringPrim::F_PERMANENT;
     }
@@ -2729,20 +4268,24 @@ const StringPrim * Runtime::internString (const StringPrim * str)
     if (JS_UNLIKELY(str->isInterned()))
         return str;
 
-    auto res = permStrings.insert(std::make_pair(PasStr(str->byteLength, str->_str), str));
-    if (res.second) {
-        str->stringFlags |= StringPrim::F_INTERNED;
-        return str;
-    } else {
-        return res.first->second;
-    }
+    if (const StringPrim * res = permStrings.find(str->chars(), str->byteLength, str->hash()))
+        return res;
+
+    // Property maps keep getStr() as the key, so a slice must not depend on its parent for it
+    if (str->isSlice() && !(str->stringFlags & StringPrim::F_SLICE_COPY) && !str->copySlice())
+        throw std::bad_alloc();
+
+    str->stringFlags |= StringPrim::F_INTERNED;
+    if (!(str->stringFlags & StringPrim::F_INDEX_KNOWN))
+        str->computeIndex();
+    permStrings.insert(str);
+    return str;
 }
 
 void Runtime::uninternString (StringPrim * str)
 {
     assert((str->stringFlags & (StringPrim::F_INTERNED | StringPrim::F_PERMANENT)) == StringPrim::F_INTERNED);
-    size_t t = this->permStrings.erase(PasStr(str->byteLength, str->_str));
-    assert(t == 1);
+    this->permStrings.remove(str);
     str->stringFlags &= ~StringPrim::F_INTERNED;
 }
 
@@ -2757,34 +4300,200 @@ void Runtime::initStrings (
 /**
  * @throws if parent is not an object or null
  */
-Object * objectCreate (StackFrame * caller, TaggedValue parent)
+Object * objectCreate (StackFrame * caller, TaggedValue parent, AllocSite * site)
 {
     if (isValueTagObject(parent.tag))
-        return parent.raw.oval->createDescendant(caller);
+        return parent.raw.oval->createDescendant(caller, site);
     else if (parent.tag == VT_NULL)
-        return newInit<Object>(caller, NULL);
+        return Object::make(caller, NULL, site);
     else {
         throwTypeError(caller, "Object prototype may only be an Object or null");
         return NULL;
     }
 }
 
-TaggedValue newFunction (StackFrame * caller, Env * env, const StringPrim * name, unsigned length, CodePtr code)
+Object * objectCreateLiteral (StackFrame * caller, TaggedValue parent, ObjectBoilerplate * bp, const TaggedValue * values)
 {
-    StackFrameN<0, 2, 0> frame(caller, env, __FILE__ ":newFunction", __LINE__);
-    Function * func;
-    frame.locals[0] = makeObjectValue(
-        func = new(&frame) Function(JS_GET_RUNTIME(&frame)->functionPrototype));
-    func->init(&frame, env, code, code, name, length);
+    Object * obj = objectCreate(caller, parent, &bp->site);
+    // The names are distinct and they are not indexes, so there is nothing to look up. Note that object
+    // literals define their properties, so setters in the prototype must not be invoked.
+    for ( unsigned i = 0; i < bp->count; ++i )
+        obj->addOwnProperty(caller, bp->strings[bp->names[i]], PROP_NORMAL, values[i]);
+    return obj;
+}
 
-    Object * prototype = newInit<Object>(&frame, &frame.locals[1], JS_GET_RUNTIME(&frame)->objectPrototype);
-    prototype->defineOwnProperty(
-        &frame, JS_GET_RUNTIME(caller)->permStrConstructor, PROP_WRITEABLE | PROP_CONFIGURABLE, frame.locals[0]
-    );
+Object * arrayCreateConst (StackFrame * caller, TaggedValue parent, const ArrayBoilerplate * bp)
+{
+    Object * obj = objectCreate(caller, parent);
+    assert(obj->getInternalClass() == ICLS_ARRAY);
+    ArrayBase * arr = static_cast<ArrayBase *>(obj);
+    arr->elems.share(bp->elems, bp->length);
+    arr->holeCount = bp->holeCount;
+    arr->numbersOnly = bp->numbersOnly;
+    return arr;
+}
+
+enum DescriptorField
+{
+    DESC_ENUMERABLE, DESC_CONFIGURABLE, DESC_VALUE, DESC_WRITABLE, DESC_GET, DESC_SET, DESC_COUNT
+};
 
-    func->definePrototype(&frame, prototype, PROP_WRITEABLE);
+static void descriptorNames (Runtime * r, const StringPrim ** names)
+{
+    names[DESC_ENUMERABLE] = r->permStrEnumerable;
+    names[DESC_CONFIGURABLE] = r->permStrConfigurable;
+    names[DESC_VALUE] = r->permStrValue;
+    names[DESC_WRITABLE] = r->permStrWritable;
+    names[DESC_GET] = r->permStrGet;
+    names[DESC_SET] = r->permStrSet;
+}
 
-    return frame.locals[0];
+/**
+ * The fast path of toPropertyDescriptor() for descriptors created by object literals: collect the fields in a
+ * single pass over the own properties instead of looking up each of them in the whole prototype chain.
+ *
+ * @return false if the descriptor must be examined the slow way
+ */
+static bool scanLiteralDescriptor (Runtime * r, Object * desc, TaggedValue * fields, unsigned * present)
+{
+    if (desc->getInternalClass() != ICLS_OBJECT || desc->parent != r->objectPrototype)
+        return false;
+
+    const StringPrim * names[DESC_COUNT];
+    descriptorNames(r, names);
+
+    if (r->descriptorEpoch != r->protoEpoch) {
+        for ( unsigned i = 0; i < DESC_COUNT; ++i )
+            if (r->objectPrototype->getOwnProperty(names[i]))
+                return false;
+        r->descriptorEpoch = r->protoEpoch;
+    }
+
+    unsigned mask = 0;
+    for ( const ListEntry * entry = desc->propList.next; entry != &desc->propList; entry = entry->next ) {
+        const Property * prop = static_cast<const Property *>(entry);
+        // Property names are interned, so comparing the pointers is enough
+        for ( unsigned i = 0; i < DESC_COUNT; ++i ) {
+            if (prop->name == names[i]) {
+                // A getter could have side effects, so let the slow path invoke them in the right order
+                if (prop->flags & PROP_GET_SET)
+                    return false;
+                fields[i] = prop->value;
+                mask |= 1 << i;
+                break;
+            }
+        }
+    }
+    *present = mask;
+    return true;
+}
+
+unsigned toPropertyDescriptor (StackFrame * caller, TaggedValue desc, TaggedValue * value)
+{
+    StackFrameN<0,DESC_COUNT,0> frame(caller, NULL, __FILE__ ":toPropertyDescriptor", __LINE__);
+    Runtime * r = JS_GET_RUNTIME(&frame);
+    TaggedValue * fields = frame.locals;
+    unsigned present = 0;
+
+    if (desc.tag == VT_UNDEFINED) {
+        // Treated as an empty descriptor
+    } else if (!isValueTagObject(desc.tag)) {
+        throwTypeError(&frame, "Property description must be an object");
+    } else if (!scanLiteralDescriptor(r, desc.raw.oval, fields, &present)) {
+        const StringPrim * names[DESC_COUNT];
+        descriptorNames(r, names);
+        for ( unsigned i = 0; i < DESC_COUNT; ++i ) {
+            if (desc.raw.oval->hasProperty(names[i])) {
+                fields[i] = desc.raw.oval->get(&frame, names[i]);
+                present |= 1 << i;
+            }
+        }
+    }
+
+    unsigned flags = 0;
+    if (present & (1 << DESC_ENUMERABLE))
+        flags |= PROP_HAVE_ENUMERABLE | (toBoolean(fields[DESC_ENUMERABLE]) ? PROP_ENUMERABLE : 0);
+    if (present & (1 << DESC_CONFIGURABLE))
+        flags |= PROP_HAVE_CONFIGURABLE | (toBoolean(fields[DESC_CONFIGURABLE]) ? PROP_CONFIGURABLE : 0);
+    if (present & (1 << DESC_WRITABLE))
+        flags |= PROP_HAVE_WRITABLE | (toBoolean(fields[DESC_WRITABLE]) ? PROP_WRITEABLE : 0);
+
+    if (present & ((1 << DESC_GET) | (1 << DESC_SET))) {
+        if (present & ((1 << DESC_VALUE) | (1 << DESC_WRITABLE)))
+            throwTypeError(&frame, "Cannot specify 'value' or 'writable' with get/set");
+
+        Function * get = NULL, * set = NULL;
+        if ((present & (1 << DESC_GET)) && !(get = isFunction(fields[DESC_GET])) &&
+            fields[DESC_GET].tag != VT_UNDEFINED)
+        {
+            throwTypeError(&frame, "'get' is not a function");
+        }
+        if ((present & (1 << DESC_SET)) && !(set = isFunction(fields[DESC_SET])) &&
+            fields[DESC_SET].tag != VT_UNDEFINED)
+        {
+            throwTypeError(&frame, "'set' is not a function");
+        }
+
+        flags |= PROP_GET_SET;
+        *value = makePropertyAccessorValue(new(&frame) PropertyAccessor(get, set));
+    } else if (present & (1 << DESC_VALUE)) {
+        flags |= PROP_HAVE_VALUE;
+        *value = fields[DESC_VALUE];
+    } else {
+        *value = JS_UNDEFINED_VALUE;
+    }
+
+    return flags;
+}
+
+void definePropertyFromDescriptor (StackFrame * caller, Object * obj, const StringPrim * name, TaggedValue desc)
+{
+    StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":definePropertyFromDescriptor", __LINE__);
+    unsigned flags = toPropertyDescriptor(&frame, desc, &frame.locals[0]);
+    obj->defineOwnPropertyExplicitThrowing(&frame, name, flags, frame.locals[0]);
+}
+
+/**
+ * ES5.1 15.2.3.7: all descriptors are converted before any property is defined, so an exception from a
+ * getter of a descriptor leaves the object unchanged.
+ */
+void definePropertiesFromObject (StackFrame * caller, Object * obj, TaggedValue props)
+{
+    StackFrameN<0,4,0> frame(caller, NULL, __FILE__ ":definePropertiesFromObject", __LINE__);
+    Object * src = toObject(&frame, props);
+    frame.locals[0] = makeObjectValue(src);
+    Array * keys = src->ownKeys(&frame);
+    frame.locals[1] = makeObjectValue(keys);
+    uint32_t count = keys->getLength();
+
+    // The converted descriptors as pairs of flags and value
+    Array * descs;
+    frame.locals[2] = makeObjectValue(descs = new(&frame) Array(JS_GET_RUNTIME(&frame)->arrayPrototype));
+    descs->init(&frame);
+    descs->elems.resize(count * 2);
+
+    for ( uint32_t i = 0; i != count; ++i ) {
+        // The keys of indexed objects are numbers
+        keys->elems[i] = toString(&frame, keys->elems[i]);
+        frame.locals[3] = src->getComputed(&frame, keys->elems[i]);
+        unsigned flags = toPropertyDescriptor(&frame, frame.locals[3], &frame.locals[3]);
+        descs->elems[i * 2] = makeNumberValue(flags);
+        descs->elems[i * 2 + 1] = frame.locals[3];
+    }
+
+    for ( uint32_t i = 0; i != count; ++i ) {
+        obj->defineOwnPropertyExplicitThrowing(
+            &frame, keys->elems[i].raw.sval, (unsigned)descs->elems[i * 2].raw.nval, descs->elems[i * 2 + 1]
+        );
+    }
+}
+
+TaggedValue newFunction (StackFrame * caller, Env * env, const StringPrim * name, unsigned length, CodePtr code)
+{
+    Function * func = new(caller) Function(JS_GET_RUNTIME(caller)->functionPrototype);
+    // The properties and the prototype object are created on first use
+    func->initLazy(env, code, code, name, length);
+    return makeObjectValue(func);
 }
 
 static void unhandledException (StackFrame * caller) JS_NORETURN;
@@ -2857,16 +4566,57 @@ TaggedValue callCons (StackFrame * caller, TaggedValue value, unsigned argc, con
 
 bool isIndexString (const char * str, uint32_t * res)
 {
-    if (str[0] >= '0' && str[0] <= '9') { // Filter out the obvious cases
-        char * end;
-        errno = 0;
-        unsigned long ul = strtoul(str, &end, 10);
-        if (errno == 0 && *end == 0 && ul < UINT32_MAX) {
-            *res = (uint32_t)ul;
-            return true;
-        }
+    const unsigned char * p = (const unsigned char *)str;
+    unsigned d = *p - '0';
+    if (d > 9) // Filter out the obvious cases
+        return false;
+    // Leading zeroes are not allowed, since the string must be the result of ToString()
+    if (d == 0) {
+        *res = 0;
+        return p[1] == 0;
+    }
+
+    // At most 10 digits, so we can't overflow 64 bits
+    uint64_t n = d;
+    while ((d = *++p - '0') <= 9) {
+        n = n * 10 + d;
+        if (n >= UINT32_MAX)
+            return false;
+    }
+    if (*p != 0)
+        return false;
+
+    *res = (uint32_t)n;
+    return true;
+}
+
+/**
+ * FNV-1a
+ */
+uint32_t StringPrim::hashChars (const unsigned char * str, unsigned length)
+{
+    uint32_t h = 2166136261u;
+    for ( const unsigned char * e = str + length; str != e; ++str )
+        h = (h ^ *str) * 16777619u;
+    return h;
+}
+
+void StringPrim::computeHash () const
+{
+    this->hashValue = hashChars(chars(), this->byteLength);
+    this->stringFlags |= F_HASH_KNOWN;
+}
+
+void StringPrim::computeIndex () const
+{
+    uint32_t index;
+    // An index has at most 10 digits. Checking that first also avoids copying long slices.
+    if (this->byteLength <= 10 && isIndexString(getStr(), &index)) {
+        this->indexValue = index;
+        this->stringFlags |= F_INDEX_KNOWN | F_INDEX;
+    } else {
+        this->stringFlags |= F_INDEX_KNOWN;
     }
-    return false;
 }
 
 InternalClass getInternalClass (TaggedValue a)
@@ -2976,7 +4726,7 @@ TaggedValue getComputed (StackFrame * caller, TaggedValue obj, TaggedValue propN
 
             StackFrameN<0,1,0> frame(caller, NULL, __FILE__ ":getComputed", __LINE__);
             frame.locals[0] = toString(&frame, propName);
-            if (isIndexString(frame.locals[0].raw.sval->getStr(), &index))
+            if (frame.locals[0].raw.sval->isIndex(&index))
                 return obj.raw.sval->charAt(&frame, index);
 
             Runtime * r = JS_GET_RUNTIME(caller);
@@ -3128,21 +4878,21 @@ double toInteger (double n)
     return n >= 0 ? floor(n) : ceil(n);
 }
 
-uint32_t toUint32 (StackFrame * caller, TaggedValue v)
-{
-    return toUint32(toNumber(caller, v));
-}
-int32_t toInt32 (StackFrame * caller, TaggedValue v)
-{
-    return toInt32(toNumber(caller, v));
-}
-
 TaggedValue concatString (StackFrame * caller, StringPrim * a, StringPrim * b)
 {
+    if (a->byteLength == 0)
+        return makeStringValue(b);
+    if (b->byteLength == 0)
+        return makeStringValue(a);
+
+    // Appending repeatedly to a long string would copy it every time, so build a rope instead
+    if (a->byteLength + b->byteLength >= StringPrim::ROPE_MIN_LENGTH)
+        return makeStringValue(StringPrim::makeRope(caller, a, b));
+
     StringPrim * res = StringPrim::makeEmpty(caller, a->byteLength + b->byteLength);
-    memcpy( res->_str, a->_str, a->byteLength);
-    memcpy( res->_str+a->byteLength, b->_str, b->byteLength);
-    res->init();
+    memcpy( res->_str, a->chars(), a->byteLength);
+    memcpy( res->_str+a->byteLength, b->chars(), b->byteLength);
+    res->init(a->charLength + b->charLength);
     return makeStringValue(res);
 }
 
@@ -3153,7 +4903,17 @@ bool less (const StringPrim * a, const StringPrim * b)
 
 bool equal (const StringPrim * a, const StringPrim * b)
 {
-    return a == b || strcmp(a->getStr(), b->getStr()) == 0;
+    if (a == b)
+        return true;
+    if (a->byteLength != b->byteLength)
+        return false;
+    // There is only one interned string with given characters
+    if (a->isInterned() && b->isInterned())
+        return false;
+    // Don't compute the hashes here, but use them if they are available
+    if ((a->stringFlags & b->stringFlags & StringPrim::F_HASH_KNOWN) && a->hashValue != b->hashValue)
+        return false;
+    return memcmp(a->chars(), b->chars(), a->byteLength) == 0;
 }
 
 }
@@ -4,6 +4,11 @@
 
 #include "jsc/jsruntime.h"
 
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace js {
 
 namespace {
@@ -15,8 +20,8 @@ namespace {
             return str;
 
         StringPrim * res = StringPrim::makeEmpty(caller, str->byteLength);
-        const unsigned char * s = str->_str;
-        const unsigned char * e = str->_str + str->byteLength;
+        const unsigned char * s = str->chars();
+        const unsigned char * e = s + str->byteLength;
         unsigned char * d = res->_str;
         bool changed = false;
 
@@ -67,31 +72,165 @@ const StringPrim * toUpperCase (StackFrame * caller, const StringPrim * str)
     return convert(caller, str, upper());
 };
 
-const void * _memmem (const void * big, size_t biglen, void * little, size_t littlelen)
+// Substring search.
+//
+// Needles of one byte go to memchr(). Short needles, and any needle in a short haystack, use a filter on
+// the first and the last byte of the needle (16 positions at a time with SSE2), and memcmp() only the
+// positions which pass it. Long needles in long haystacks use Boyer-Moore-Horspool, which can skip up to
+// the length of the needle at a time, but needs a table which isn't worth building for a short search.
+
+namespace {
+
+const size_t HORSPOOL_MIN_NEEDLE = 32;
+const size_t HORSPOOL_MIN_HAYSTACK = 1024;
+
+inline bool matchesAt (const unsigned char * b, const unsigned char * l, size_t len)
+{
+    return b[0] == l[0] && b[len - 1] == l[len - 1] && ::memcmp(b + 1, l + 1, len - 2) == 0;
+}
+
+/**
+ * The first/last byte filter. 'len' must be at least 2.
+ */
+const unsigned char * filterSearch (const unsigned char * b, size_t blen, const unsigned char * l, size_t len)
+{
+    size_t npos = blen - len + 1; // Number of candidate positions
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i first = _mm_set1_epi8((char)l[0]);
+    const __m128i last = _mm_set1_epi8((char)l[len - 1]);
+    for ( ; i + 16 <= npos; i += 16 ) {
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(
+            _mm_cmpeq_epi8(first, _mm_loadu_si128((const __m128i *)(b + i))),
+            _mm_cmpeq_epi8(last, _mm_loadu_si128((const __m128i *)(b + i + len - 1)))));
+        for ( ; mask; mask &= mask - 1 ) {
+            const unsigned char * p = b + i + __builtin_ctz(mask);
+            if (::memcmp(p + 1, l + 1, len - 2) == 0)
+                return p;
+        }
+    }
+    for ( ; i < npos; ++i )
+        if (matchesAt(b + i, l, len))
+            return b + i;
+#else
+    while (i < npos) {
+        const unsigned char * p = (const unsigned char *)::memchr(b + i, l[0], npos - i);
+        if (!p)
+            break;
+        if (matchesAt(p, l, len))
+            return p;
+        i = p - b + 1;
+    }
+#endif
+    return NULL;
+}
+
+/**
+ * The first/last byte filter searching backwards. 'len' must be at least 2.
+ */
+const unsigned char * filterSearchReverse (
+    const unsigned char * b, size_t blen, const unsigned char * l, size_t len
+)
+{
+    size_t i = blen - len + 1; // Positions [0, i) remain to be checked
+
+#ifdef __SSE2__
+    const __m128i first = _mm_set1_epi8((char)l[0]);
+    const __m128i last = _mm_set1_epi8((char)l[len - 1]);
+    for ( ; i >= 16; i -= 16 ) {
+        const unsigned char * block = b + i - 16;
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(
+            _mm_cmpeq_epi8(first, _mm_loadu_si128((const __m128i *)block)),
+            _mm_cmpeq_epi8(last, _mm_loadu_si128((const __m128i *)(block + len - 1)))));
+        while (mask) {
+            unsigned bit = 31 - __builtin_clz(mask);
+            if (::memcmp(block + bit + 1, l + 1, len - 2) == 0)
+                return block + bit;
+            mask &= ~(1u << bit);
+        }
+    }
+#endif
+    while (i--)
+        if (matchesAt(b + i, l, len))
+            return b + i;
+    return NULL;
+}
+
+const unsigned char * horspoolSearch (const unsigned char * b, size_t blen, const unsigned char * l, size_t len)
+{
+    size_t shift[256];
+    for ( unsigned c = 0; c < 256; ++c )
+        shift[c] = len;
+    // The last byte is excluded, so a byte always moves the window forward
+    for ( size_t i = 0; i < len - 1; ++i )
+        shift[l[i]] = len - 1 - i;
+
+    const unsigned char * last = b + blen - len;
+    for ( const unsigned char * p = b; p <= last; p += shift[p[len - 1]] )
+        if (matchesAt(p, l, len))
+            return p;
+    return NULL;
+}
+
+/**
+ * Boyer-Moore-Horspool moving backwards: the shift is keyed on the first byte of the window.
+ */
+const unsigned char * horspoolSearchReverse (
+    const unsigned char * b, size_t blen, const unsigned char * l, size_t len
+)
+{
+    size_t shift[256];
+    for ( unsigned c = 0; c < 256; ++c )
+        shift[c] = len;
+    for ( size_t i = len - 1; i > 0; --i )
+        shift[l[i]] = i;
+
+    for ( size_t pos = blen - len;; ) {
+        if (matchesAt(b + pos, l, len))
+            return b + pos;
+        size_t s = shift[b[pos]];
+        if (s > pos)
+            return NULL;
+        pos -= s;
+    }
+}
+
+}; // anonymous namespace
+
+const void * _memmem (const void * big, size_t biglen, const void * little, size_t littlelen)
 {
     if (JS_UNLIKELY(littlelen > biglen))
         return NULL;
+    if (JS_UNLIKELY(littlelen == 0))
+        return big;
 
-    const char * b = (const char *)big;
-    const char * e =  b + biglen - littlelen + 1;
-    do {
-        if (::memcmp(b, little, littlelen) == 0)
-            return b;
-    } while (++b < e);
-    return NULL;
+    const unsigned char * b = (const unsigned char *)big;
+    const unsigned char * l = (const unsigned char *)little;
+    if (littlelen == 1)
+        return ::memchr(b, l[0], biglen);
+    if (littlelen >= HORSPOOL_MIN_NEEDLE && biglen >= HORSPOOL_MIN_HAYSTACK)
+        return horspoolSearch(b, biglen, l, littlelen);
+    return filterSearch(b, biglen, l, littlelen);
 }
 
-const void * memrmem (const void * big, size_t biglen, void * little, size_t littlelen)
+const void * memrmem (const void * big, size_t biglen, const void * little, size_t littlelen)
 {
     if (JS_UNLIKELY(littlelen > biglen))
         return NULL;
 
-    const char * b = (const char *)big;
-    const char * e =  b + biglen - littlelen;
-    do {
-        if (::memcmp(e, little, littlelen) == 0)
-            return e;
-    } while (e-- > b);
-    return NULL;
+    const unsigned char * b = (const unsigned char *)big;
+    const unsigned char * l = (const unsigned char *)little;
+    if (JS_UNLIKELY(littlelen == 0))
+        return b + biglen;
+    if (littlelen == 1) {
+        for ( const unsigned char * p = b + biglen; p != b; )
+            if (*--p == l[0])
+                return p;
+        return NULL;
+    }
+    if (littlelen >= HORSPOOL_MIN_NEEDLE && biglen >= HORSPOOL_MIN_HAYSTACK)
+        return horspoolSearchReverse(b, biglen, l, littlelen);
+    return filterSearchReverse(b, biglen, l, littlelen);
 }
 }; // namespace js
@@ -16,11 +16,6 @@ ArrayBuffer::~ArrayBuffer ()
         free(data);
 }
 
-InternalClass ArrayBuffer::getInternalClass () const
-{
-    return ICLS_ArrayBuffer;
-}
-
 void ArrayBuffer::allocateBuffer (StackFrame * caller, double flen)
 {
     if (flen < 0 || flen > SIZE_MAX)
@@ -50,11 +45,6 @@ TaggedValue ArrayBuffer::aFunction (StackFrame * caller, Env * env, unsigned arg
     throwTypeError(caller, "ArrayBuffer requires 'new'");
 }
 
-InternalClass DataView::getInternalClass () const
-{
-    return ICLS_DataView;
-}
-
 bool DataView::mark (IMark * marker, unsigned markBit) const
 {
     return markMemory(marker, markBit, this->buffer);
@@ -6,6 +6,12 @@
 #include "jsc/common.h"
 
 #include <stddef.h>
+#include <string.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#define JS_UTF8_X86 1
+#include <immintrin.h>
+#endif
 
 namespace js {
 
@@ -89,6 +95,12 @@ unsigned utf8Length (const unsigned char * from, const unsigned char * to)
     unsigned length = 0;
 
     while (from < to) {
+        if (!(*from & 0x80)) {
+            const unsigned char * ascii = utf8SkipASCII(from, to);
+            length += (unsigned)(ascii - from);
+            if ((from = ascii) == to)
+                break;
+        }
         ++length;
         from += utf8CodePointLength(*from);
     }
@@ -259,4 +271,418 @@ uint32_t utf8DecodeFast (const unsigned char * from)
         return ((ch & 0x07) << 18) | ((ch1 & 0x3F) << 12) | ((ch2 & 0x3F) << 6) | (ch3 & 0x3F);
     }
 }
+
+// ---------------------------------------------------------------------------------------------------------------
+// Bulk operations over UTF-8 buffers.
+//
+// The portable versions work a word or a byte at a time. On x86 there are SSE2 and AVX2 versions, and a
+// table-driven SSSE3/AVX2 validator (after Keiser and Lemire, "Validating UTF-8 In Less Than One Instruction
+// Per Byte"). The best available version is picked at runtime.
+//
+// Counting UTF-16 units relies on the input being valid: every byte which is not a continuation byte starts
+// a code point and every 4-byte lead adds a second surrogate.
+
+static const unsigned char * skipASCIIScalar (const unsigned char * from, const unsigned char * to)
+{
+    while (to - from >= 8) {
+        uint64_t w;
+        memcpy(&w, from, sizeof(w));
+        if (w & UINT64_C(0x8080808080808080))
+            break;
+        from += 8;
+    }
+    while (from < to && !(*from & 0x80))
+        ++from;
+    return from;
+}
+
+static unsigned lengthInUTF16UnitsScalar (const unsigned char * from, const unsigned char * to)
+{
+    unsigned length = 0;
+    for ( ; from < to; ++from ) {
+        unsigned ch = *from;
+        length += ((ch & 0xC0) != 0x80) + (ch >= 0xF0);
+    }
+    return length;
+}
+
+static bool isValidScalar (const unsigned char * from, const unsigned char * to)
+{
+    for(;;) {
+        if ((from = skipASCIIScalar(from, to)) == to)
+            return true;
+
+        // Reject the leads which utf8Decode() could read past the end for
+        unsigned ch = *from;
+        if (JS_UNLIKELY((ch & 0xC0) == 0x80 || ch >= 0xF8 || utf8CodePointLength(ch) > to - from))
+            return false;
+
+        uint32_t cp;
+        from = utf8Decode(from, &cp);
+        if (JS_UNLIKELY(cp == UNICODE_ERROR))
+            return false;
+    }
+}
+
+#ifdef JS_UTF8_X86
+
+static const unsigned char * skipASCII_sse2 (const unsigned char * from, const unsigned char * to)
+{
+    for ( ; to - from >= 16; from += 16 ) {
+        if (int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)from)))
+            return from + __builtin_ctz(mask);
+    }
+    return skipASCIIScalar(from, to);
+}
+
+static uint64_t sum64 (__m128i v)
+{
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, v);
+    return lanes[0] + lanes[1];
+}
+
+static unsigned lengthInUTF16Units_sse2 (const unsigned char * from, const unsigned char * to)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i contEnd = _mm_set1_epi8((char)0xC0);
+    const __m128i fourStart = _mm_set1_epi8((char)0xF0);
+    const unsigned char * start = from;
+    __m128i contTotal = zero, fourTotal = zero;
+
+    while (to - from >= 16) {
+        // The per-byte counters overflow after 255 blocks
+        size_t blocks = (size_t)(to - from) / 16;
+        if (blocks > 255)
+            blocks = 255;
+
+        __m128i cont = zero, four = zero;
+        for ( ; blocks; --blocks, from += 16 ) {
+            __m128i v = _mm_loadu_si128((const __m128i *)from);
+            // 0x80..0xBF are exactly the bytes below 0xC0 when compared as signed
+            cont = _mm_sub_epi8(cont, _mm_cmplt_epi8(v, contEnd));
+            four = _mm_sub_epi8(four, _mm_cmpeq_epi8(_mm_max_epu8(v, fourStart), v));
+        }
+        contTotal = _mm_add_epi64(contTotal, _mm_sad_epu8(cont, zero));
+        fourTotal = _mm_add_epi64(fourTotal, _mm_sad_epu8(four, zero));
+    }
+
+    return (unsigned)((from - start) - sum64(contTotal) + sum64(fourTotal)) +
+           lengthInUTF16UnitsScalar(from, to);
+}
+
+static bool isValid_sse2 (const unsigned char * from, const unsigned char * to)
+{
+    for(;;) {
+        if ((from = skipASCII_sse2(from, to)) == to)
+            return true;
+
+        unsigned ch = *from;
+        if (JS_UNLIKELY((ch & 0xC0) == 0x80 || ch >= 0xF8 || utf8CodePointLength(ch) > to - from))
+            return false;
+
+        uint32_t cp;
+        from = utf8Decode(from, &cp);
+        if (JS_UNLIKELY(cp == UNICODE_ERROR))
+            return false;
+    }
+}
+
+// Every pair of adjacent bytes is classified by three table lookups: the high and low nibble of the first
+// byte and the high nibble of the second. Each bit stands for one kind of error, and it survives the AND of
+// the three lookups only if all of them agree.
+enum : uint8_t
+{
+    TOO_SHORT = 1 << 0,     // 11______ 0_______ or 11______ 11______
+    TOO_LONG = 1 << 1,      // 0_______ 10______
+    OVERLONG_3 = 1 << 2,    // 11100000 100_____
+    TOO_LARGE = 1 << 3,     // 11110100 1001____ and above
+    SURROGATE = 1 << 4,     // 11101101 101_____
+    OVERLONG_2 = 1 << 5,    // 1100000_ 10______
+    TOO_LARGE_1000 = 1 << 6,// 11110101 1000____ and above
+    OVERLONG_4 = 1 << 6,    // 11110000 1000____
+    TWO_CONTS = 1 << 7,     // 10______ 10______
+    CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS,
+};
+
+static const uint8_t s_byte1High[16] = {
+    // 0_______ ASCII
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+    // 10______ continuation
+    TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+    // 1100____ 2-byte lead
+    TOO_SHORT | OVERLONG_2,
+    // 1101____ 2-byte lead
+    TOO_SHORT,
+    // 1110____ 3-byte lead
+    TOO_SHORT | OVERLONG_3 | SURROGATE,
+    // 1111____ 4-byte or longer lead
+    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+};
+
+static const uint8_t s_byte1Low[16] = {
+    // ____0000
+    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+    // ____0001
+    CARRY | OVERLONG_2,
+    // ____001_
+    CARRY,
+    CARRY,
+    // ____0100
+    CARRY | TOO_LARGE,
+    // ____0101 and above
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    // ____1101
+    CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+};
+
+static const uint8_t s_byte2High[16] = {
+    // 0_______ ASCII
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+    // 1000____
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+    // 1001____
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+    // 101_____
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    // 11______ lead
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+};
+
+// Subtracting these leaves a non-zero byte where a sequence starting in the last three bytes of a block is
+// not finished in it
+static const uint8_t s_incompleteMax[32] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1,
+};
+
+__attribute__((target("ssse3")))
+static bool isValid_ssse3 (const unsigned char * from, const unsigned char * to)
+{
+    const __m128i byte1High = _mm_loadu_si128((const __m128i *)s_byte1High);
+    const __m128i byte1Low = _mm_loadu_si128((const __m128i *)s_byte1Low);
+    const __m128i byte2High = _mm_loadu_si128((const __m128i *)s_byte2High);
+    const __m128i incompleteMax = _mm_loadu_si128((const __m128i *)(s_incompleteMax + 16));
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i third = _mm_set1_epi8((char)(0xE0 - 0x80));
+    const __m128i fourth = _mm_set1_epi8((char)(0xF0 - 0x80));
+    const __m128i high = _mm_set1_epi8((char)0x80);
+
+    __m128i error = _mm_setzero_si128();
+    __m128i prev = _mm_setzero_si128();
+    __m128i prevIncomplete = _mm_setzero_si128();
+    unsigned char tail[16];
+
+    for(;;) {
+        __m128i in;
+        if (to - from >= 16) {
+            in = _mm_loadu_si128((const __m128i *)from);
+            from += 16;
+        } else if (from < to) {
+            // Pad the tail with zeroes, so a truncated sequence shows up as TOO_SHORT
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, from, to - from);
+            in = _mm_loadu_si128((const __m128i *)tail);
+            from = to;
+        } else {
+            break;
+        }
+
+        if (JS_LIKELY(_mm_movemask_epi8(in) == 0)) {
+            // All ASCII: only a sequence left over from the previous block can be wrong
+            error = _mm_or_si128(error, prevIncomplete);
+        } else {
+            __m128i prev1 = _mm_alignr_epi8(in, prev, 15);
+            __m128i special = _mm_and_si128(
+                _mm_and_si128(
+                    _mm_shuffle_epi8(byte1High, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                    _mm_shuffle_epi8(byte1Low, _mm_and_si128(prev1, nibble))),
+                _mm_shuffle_epi8(byte2High, _mm_and_si128(_mm_srli_epi16(in, 4), nibble)));
+
+            // A continuation must follow a lead, and two consecutive continuations are only allowed as the
+            // third or fourth byte of a sequence
+            __m128i prev2 = _mm_alignr_epi8(in, prev, 14);
+            __m128i prev3 = _mm_alignr_epi8(in, prev, 13);
+            __m128i mustBeCont = _mm_and_si128(
+                _mm_or_si128(_mm_subs_epu8(prev2, third), _mm_subs_epu8(prev3, fourth)), high);
+
+            error = _mm_or_si128(error, _mm_xor_si128(mustBeCont, special));
+            prevIncomplete = _mm_subs_epu8(in, incompleteMax);
+        }
+        prev = in;
+    }
+
+    error = _mm_or_si128(error, prevIncomplete);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+}
+
+__attribute__((target("avx2")))
+static const unsigned char * skipASCII_avx2 (const unsigned char * from, const unsigned char * to)
+{
+    for ( ; to - from >= 32; from += 32 ) {
+        if (unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)from)))
+            return from + __builtin_ctz(mask);
+    }
+    return skipASCII_sse2(from, to);
+}
+
+__attribute__((target("avx2")))
+static unsigned lengthInUTF16Units_avx2 (const unsigned char * from, const unsigned char * to)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i contEnd = _mm256_set1_epi8((char)0xC0);
+    const __m256i fourStart = _mm256_set1_epi8((char)0xF0);
+    const unsigned char * start = from;
+    __m256i contTotal = zero, fourTotal = zero;
+
+    while (to - from >= 32) {
+        size_t blocks = (size_t)(to - from) / 32;
+        if (blocks > 255)
+            blocks = 255;
+
+        __m256i cont = zero, four = zero;
+        for ( ; blocks; --blocks, from += 32 ) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)from);
+            cont = _mm256_sub_epi8(cont, _mm256_cmpgt_epi8(contEnd, v));
+            four = _mm256_sub_epi8(four, _mm256_cmpeq_epi8(_mm256_max_epu8(v, fourStart), v));
+        }
+        contTotal = _mm256_add_epi64(contTotal, _mm256_sad_epu8(cont, zero));
+        fourTotal = _mm256_add_epi64(fourTotal, _mm256_sad_epu8(four, zero));
+    }
+
+    __m128i cont = _mm_add_epi64(_mm256_castsi256_si128(contTotal), _mm256_extracti128_si256(contTotal, 1));
+    __m128i four = _mm_add_epi64(_mm256_castsi256_si128(fourTotal), _mm256_extracti128_si256(fourTotal, 1));
+    return (unsigned)((from - start) - sum64(cont) + sum64(four)) + lengthInUTF16Units_sse2(from, to);
+}
+
+__attribute__((target("avx2")))
+static bool isValid_avx2 (const unsigned char * from, const unsigned char * to)
+{
+    const __m256i byte1High = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)s_byte1High));
+    const __m256i byte1Low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)s_byte1Low));
+    const __m256i byte2High = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)s_byte2High));
+    const __m256i incompleteMax = _mm256_loadu_si256((const __m256i *)s_incompleteMax);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i third = _mm256_set1_epi8((char)(0xE0 - 0x80));
+    const __m256i fourth = _mm256_set1_epi8((char)(0xF0 - 0x80));
+    const __m256i high = _mm256_set1_epi8((char)0x80);
+
+    __m256i error = _mm256_setzero_si256();
+    __m256i prev = _mm256_setzero_si256();
+    __m256i prevIncomplete = _mm256_setzero_si256();
+    unsigned char tail[32];
+
+    for(;;) {
+        __m256i in;
+        if (to - from >= 32) {
+            in = _mm256_loadu_si256((const __m256i *)from);
+            from += 32;
+        } else if (from < to) {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, from, to - from);
+            in = _mm256_loadu_si256((const __m256i *)tail);
+            from = to;
+        } else {
+            break;
+        }
+
+        if (JS_LIKELY(_mm256_movemask_epi8(in) == 0)) {
+            error = _mm256_or_si256(error, prevIncomplete);
+        } else {
+            // alignr works within 128-bit lanes, so line up the previous 16 bytes of each lane first
+            __m256i shifted = _mm256_permute2x128_si256(prev, in, 0x21);
+            __m256i prev1 = _mm256_alignr_epi8(in, shifted, 15);
+            __m256i special = _mm256_and_si256(
+                _mm256_and_si256(
+                    _mm256_shuffle_epi8(byte1High, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                    _mm256_shuffle_epi8(byte1Low, _mm256_and_si256(prev1, nibble))),
+                _mm256_shuffle_epi8(byte2High, _mm256_and_si256(_mm256_srli_epi16(in, 4), nibble)));
+
+            __m256i prev2 = _mm256_alignr_epi8(in, shifted, 14);
+            __m256i prev3 = _mm256_alignr_epi8(in, shifted, 13);
+            __m256i mustBeCont = _mm256_and_si256(
+                _mm256_or_si256(_mm256_subs_epu8(prev2, third), _mm256_subs_epu8(prev3, fourth)), high);
+
+            error = _mm256_or_si256(error, _mm256_xor_si256(mustBeCont, special));
+            prevIncomplete = _mm256_subs_epu8(in, incompleteMax);
+        }
+        prev = in;
+    }
+
+    error = _mm256_or_si256(error, prevIncomplete);
+    return _mm256_testz_si256(error, error) != 0;
+}
+
+#endif // JS_UTF8_X86
+
+namespace {
+
+struct UTF8Ops
+{
+    const unsigned char * (*skipASCII) (const unsigned char * from, const unsigned char * to);
+    bool (*isValid) (const unsigned char * from, const unsigned char * to);
+    unsigned (*lengthInUTF16Units) (const unsigned char * from, const unsigned char * to);
+};
+
+const UTF8Ops * selectUTF8Ops ()
+{
+#ifdef JS_UTF8_X86
+    static const UTF8Ops s_avx2 = { skipASCII_avx2, isValid_avx2, lengthInUTF16Units_avx2 };
+    static const UTF8Ops s_ssse3 = { skipASCII_sse2, isValid_ssse3, lengthInUTF16Units_sse2 };
+    static const UTF8Ops s_sse2 = { skipASCII_sse2, isValid_sse2, lengthInUTF16Units_sse2 };
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return &s_avx2;
+    if (__builtin_cpu_supports("ssse3"))
+        return &s_ssse3;
+    return &s_sse2;
+#else
+    static const UTF8Ops s_scalar = { skipASCIIScalar, isValidScalar, lengthInUTF16UnitsScalar };
+    return &s_scalar;
+#endif
+}
+
+inline const UTF8Ops * utf8Ops ()
+{
+    static const UTF8Ops * const s_ops = selectUTF8Ops();
+    return s_ops;
+}
+
+// Below this the dispatch costs more than it saves
+const ptrdiff_t UTF8_BULK_MIN_LENGTH = 16;
+
+}; // anonymous namespace
+
+const unsigned char * utf8SkipASCII (const unsigned char * from, const unsigned char * to)
+{
+    if (to - from < UTF8_BULK_MIN_LENGTH)
+        return skipASCIIScalar(from, to);
+    return utf8Ops()->skipASCII(from, to);
+}
+
+bool utf8IsValid (const unsigned char * from, const unsigned char * to)
+{
+    if (to - from < UTF8_BULK_MIN_LENGTH)
+        return isValidScalar(from, to);
+    return utf8Ops()->isValid(from, to);
+}
+
+unsigned utf8LengthInUTF16Units (const unsigned char * from, const unsigned char * to)
+{
+    if (to - from < UTF8_BULK_MIN_LENGTH)
+        return lengthInUTF16UnitsScalar(from, to);
+    return utf8Ops()->lengthInUTF16Units(from, to);
+}
+
 }; // namespace js
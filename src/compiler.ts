@@ -2060,6 +2060,14 @@ function compileSource (
         ctx.builder.genLoadRuntimeVar(objProto, "arrayPrototype");
         ctx.releaseTemp(objProto);
         var dest = ctx.allocTemp();
+
+        // An array of constants is created from static data, copying it only when it is modified
+        var consts = constantArrayElements(scope, e);
+        if (consts) {
+            ctx.builder.genCreateConstArray(dest, objProto, consts);
+            return dest;
+        }
+
         ctx.builder.genCreate(dest, objProto);
 
         if (e.elements.length > 0) {
@@ -2083,6 +2091,31 @@ function compileSource (
         return dest;
     }
 
+    /**
+     * If all elements of an array literal fold to constants, return them, with null for holes.
+     */
+    function constantArrayElements (scope: Scope, e: ESTree.ArrayExpression): hir.RValue[]
+    {
+        if (e.elements.length < 2)
+            return null;
+
+        var res: hir.RValue[] = [];
+        for ( var i = 0; i < e.elements.length; ++i ) {
+            var elem = e.elements[i];
+            if (!elem) {
+                res.push(null);
+            } else {
+                if (elem.type === "SpreadElement")
+                    return null;
+                var folded = tryFoldExpression(scope, elem);
+                if (folded === null)
+                    return null;
+                res.push(folded);
+            }
+        }
+        return res;
+    }
+
     function compileObjectExpression (
         scope: Scope, e: ESTree.ObjectExpression, need: boolean, onTrue: hir.Label, onFalse: hir.Label
     ): hir.RValue
@@ -2179,6 +2212,47 @@ function compileSource (
             return need ? hir.undefinedValue : null;
         }
 
+        // If there are only data properties, evaluate all values first and then create the object with all
+        // of its properties at once
+        if (props.length > 0 && props.every((propDesc) => !!propDesc.value && !propDesc.getter && !propDesc.setter)) {
+            var names: string[] = [];
+            var values: hir.RValue[] = [];
+            props.forEach((propDesc: ObjectExprProp) => {
+                if (propDesc.name === null) { // if this property was overwritten?
+                    compileSubExpression(scope, propDesc.value, false, null, null);
+                    return;
+                }
+                var val = compileSubExpression(scope, propDesc.value, true, null, null);
+                // A variable could be modified by one of the following values, so read it now
+                if (!hir.isImmediate(val) && !hir.isTempLocal(val)) {
+                    var t = ctx.allocTemp();
+                    ctx.builder.genAssign(t, val);
+                    val = t;
+                }
+                names.push(propDesc.name);
+                values.push(val);
+            });
+
+            // Note that the prototype must not overwrite any of the values
+            var objProto = ctx.allocTemp();
+            ctx.builder.genLoadRuntimeVar(objProto, "objectPrototype");
+            ctx.releaseTemp(objProto);
+            var dest: hir.Local;
+            if (hir.isLiteralShape(names)) {
+                // The values are copied before the object is created, so it can reuse one of their temps
+                for ( var i = values.length - 1; i >= 0; --i )
+                    ctx.releaseTemp(values[i]);
+                dest = ctx.allocTemp();
+            } else {
+                // The object is created first and the values are stored into it afterwards
+                dest = ctx.allocTemp();
+                for ( var i = values.length - 1; i >= 0; --i )
+                    ctx.releaseTemp(values[i]);
+            }
+            ctx.builder.genCreateLiteral(dest, objProto, names, values);
+            return dest;
+        }
+
         var objProto = ctx.allocTemp();
         ctx.builder.genLoadRuntimeVar(objProto, "objectPrototype");
         ctx.releaseTemp(objProto);
@@ -3467,6 +3541,8 @@ export function compile (
         declareBuiltinConstructor("Uint32Array", "js::Uint32Array::a", "uint32Array");
         declareBuiltinConstructor("Float32Array", "js::Float32Array::a", "float32Array");
         declareBuiltinConstructor("Float64Array", "js::Float64Array::a", "float64Array");
+        declareBuiltinConstructor("Map", "js::Map::a", "map");
+        declareBuiltinConstructor("Set", "js::Set::a", "set");
 
         runtimeCtx.scope.newConstant("NaN", hir.wrapImmediate(NaN));
         runtimeCtx.scope.newConstant("Infinity", hir.wrapImmediate(Infinity));
@@ -14,6 +14,9 @@ import hir = require("./hir");
 
 import OpCode = hir.OpCode;
 
+/** Must match js::Object::MAX_INLINE_SLOTS in the runtime */
+var MAX_INLINE_SLOTS = 16;
+
 class DynBuffer
 {
     buf: Buffer;
@@ -397,8 +400,29 @@ function functionGen (m_backend: CXXBackend, m_fb: hir.FunctionBuilder, m_obuf:
     function generateCreate (createOp: hir.UnOp): void
     {
         var callerStr: string = "&frame, ";
-        gen("  %sjs::makeObjectValue(js::objectCreate(%s%s));\n",
-            strDest(createOp.dest), callerStr, strRValue(createOp.src1)
+        gen("  %sjs::makeObjectValue(js::objectCreate(%s%s, &s_allocSites[%d]));\n",
+            strDest(createOp.dest), callerStr, strRValue(createOp.src1), m_backend.addAllocSite()
+        );
+    }
+
+    function generateCreateLiteral (createOp: hir.CreateLiteralOp): void
+    {
+        var callerStr: string = "&frame, ";
+        gen("  %sjs::makeObjectValue(js::objectCreateLiteral(%s%s, &s_boilerplates[%d], &%s));\n",
+            strDest(createOp.dest), callerStr, strRValue(createOp.proto),
+            m_backend.addBoilerplate(createOp.names), strMemValue(createOp.args[0])
+        );
+    }
+
+    function generateCreateConstArray (createOp: hir.CreateConstArrayOp): void
+    {
+        // Strings don't exist until startup, so their slots are filled in then
+        var inits = createOp.elems.map((v: hir.RValue): string =>
+            v === null ? "JS_ARRAY_HOLE_VALUE" : hir.isString(v) ? "JS_UNDEFINED_VALUE" : strRValue(v)
+        );
+        gen("  %sjs::makeObjectValue(js::arrayCreateConst(&frame, %s, &s_arrayBoilerplates[%d]));\n",
+            strDest(createOp.dest), strRValue(createOp.proto),
+            m_backend.addArrayBoilerplate(createOp.elems, inits)
         );
     }
 
@@ -449,7 +473,9 @@ function functionGen (m_backend: CXXBackend, m_fb: hir.FunctionBuilder, m_obuf:
         var l = lsigned ? strToInt32(binop.src1): strToUint32(binop.src1);
         var r = rsigned ? strToInt32(binop.src2): strToUint32(binop.src2);
 
-        gen("  %sjs::makeNumberValue(%s %s %s);\n", strDest(binop.dest), l, coper, r);
+        // The result has the type of the left operand
+        gen("  %sjs::%s(%s %s %s);\n", strDest(binop.dest),
+            lsigned ? "makeInt32Value" : "makeNumberValue", l, coper, r);
     }
 
     /**
@@ -471,7 +497,7 @@ function functionGen (m_backend: CXXBackend, m_fb: hir.FunctionBuilder, m_obuf:
 
     function generateIntegerUnop (unop: hir.UnOp, coper: string): void
     {
-        gen("  %sjs::makeNumberValue(%s%s);\n", strDest(unop.dest),
+        gen("  %sjs::makeInt32Value(%s%s);\n", strDest(unop.dest),
             coper, strToInt32(unop.src1));
     }
 
@@ -533,9 +559,12 @@ function functionGen (m_backend: CXXBackend, m_fb: hir.FunctionBuilder, m_obuf:
 
         switch (binop.op) {
             case OpCode.ADD:   generateBinopOutofline(binop); break;
-            case OpCode.ADD_N: generateNumericBinop(binop, "+"); break;
-            case OpCode.SUB_N: generateNumericBinop(binop, "-"); break;
-            case OpCode.MUL_N: generateNumericBinop(binop, "*"); break;
+            // These have int32 fast paths
+            case OpCode.ADD_N:
+            case OpCode.SUB_N:
+            case OpCode.MUL_N:
+                generateBinopOutofline(binop);
+                break;
             case OpCode.DIV_N: generateNumericBinop(binop, "/"); break;
             case OpCode.MOD_N:
                 gen("  %sjs::makeNumberValue(fmod(%s, %s));\n", strDest(binop.dest),
@@ -682,6 +711,8 @@ function functionGen (m_backend: CXXBackend, m_fb: hir.FunctionBuilder, m_obuf:
                 break;
             case OpCode.CREATE: generateCreate(<hir.UnOp>inst); break;
             case OpCode.CREATE_ARGUMENTS: generateCreateArguments(<hir.UnOp>inst); break;
+            case OpCode.CREATE_LITERAL: generateCreateLiteral(<hir.CreateLiteralOp>inst); break;
+            case OpCode.CREATE_CONST_ARRAY: generateCreateConstArray(<hir.CreateConstArrayOp>inst); break;
             case OpCode.LOAD_SC: generateLoadSC(<hir.LoadSCOp>inst); break;
             case OpCode.END_TRY:
                 var endTryOp = <hir.EndTryOp>inst;
@@ -800,8 +831,8 @@ function functionGen (m_backend: CXXBackend, m_fb: hir.FunctionBuilder, m_obuf:
                 cond = strIfIn(src1, src2);
                 break;
             case OpCode.IF_INSTANCEOF:
-                cond = util.format("operator_IF_INSTANCEOF(%s%s, %s.raw.fval)",
-                    callerStr, strRValue(src1), strRValue(src2)
+                cond = util.format("operator_IF_INSTANCEOF(%s%s, %s.raw.fval, &s_instanceOfSites[%d])",
+                    callerStr, strRValue(src1), strRValue(src2), m_backend.addInstanceOfSite()
                 );
                 break;
 
@@ -889,6 +920,15 @@ export class CXXBackend
 
     private strings : string[] = [];
     private stringMap = new StringMap<number>();
+    private allocSiteCount = 0;
+    private instanceOfSiteCount = 0;
+    /** For every object literal boilerplate, the indexes of its property names in 'strings' */
+    private boilerplates: number[][] = [];
+    /** The C initializers of the elements of all constant array literals */
+    private arrayElems: string[] = [];
+    /** Pairs of (index in arrayElems, index in 'strings') of the string elements */
+    private arrayStrings: number[] = [];
+    private arrayBoilerplates: { start: number; length: number; holeCount: number; numbersOnly: boolean }[] = [];
 
     private codeSeg = new OutputSegment();
 
@@ -914,6 +954,55 @@ export class CXXBackend
         return n;
     }
 
+    /**
+     * Allocate feedback storage for an object creation site
+     */
+    addAllocSite (): number
+    {
+        return this.allocSiteCount++;
+    }
+
+    /**
+     * Allocate a cache for an 'instanceof' site
+     */
+    addInstanceOfSite (): number
+    {
+        return this.instanceOfSiteCount++;
+    }
+
+    /**
+     * Allocate a static descriptor for an object literal with the specified property names
+     */
+    addBoilerplate (names: string[]): number
+    {
+        this.boilerplates.push(names.map((name: string) => this.addString(name)));
+        return this.boilerplates.length - 1;
+    }
+
+    /**
+     * Allocate a static descriptor for an array literal of constants (null for holes), with 'inits' the C
+     * initializers of the elements which are not strings
+     */
+    addArrayBoilerplate (elems: hir.RValue[], inits: string[]): number
+    {
+        var start = this.arrayElems.length;
+        var holeCount = 0;
+        var numbersOnly = true;
+
+        elems.forEach((v: hir.RValue, index: number) => {
+            if (v === null)
+                ++holeCount;
+            else if (typeof v !== "number")
+                numbersOnly = false;
+            if (hir.isString(v))
+                this.arrayStrings.push(start + index, this.addString(<string><any>v));
+            this.arrayElems.push(inits[index]);
+        });
+
+        this.arrayBoilerplates.push({ start: start, length: elems.length, holeCount: holeCount, numbersOnly: numbersOnly });
+        return this.arrayBoilerplates.length - 1;
+    }
+
     strFunc (fref: hir.FunctionBuilder): string
     {
         return fref.mangledName;
@@ -999,6 +1088,52 @@ export class CXXBackend
         out.write(line);
     }
 
+    private outputBoilerplates (out: NodeJS.WritableStream): void
+    {
+        if (!this.boilerplates.length)
+            return;
+
+        var allNames: number[] = [];
+        this.boilerplates.forEach((names: number[]) => allNames.push.apply(allNames, names));
+        out.write(util.format("static const unsigned s_bpnames[%d] = {%s};\n", allNames.length, allNames.join(",")));
+
+        out.write(util.format("static js::ObjectBoilerplate s_boilerplates[%d] = {\n", this.boilerplates.length));
+        var start = 0;
+        this.boilerplates.forEach((names: number[]) => {
+            // Reserve inline slots for all properties up front
+            out.write(util.format("  {{%d}, %d, s_bpnames + %d, s_strings},\n",
+                min(names.length, MAX_INLINE_SLOTS), names.length, start
+            ));
+            start += names.length;
+        });
+        out.write("};\n\n");
+    }
+
+    private outputArrayBoilerplates (out: NodeJS.WritableStream): void
+    {
+        if (!this.arrayBoilerplates.length)
+            return;
+
+        out.write(util.format("static js::TaggedValue s_arrayElems[%d] = {\n", this.arrayElems.length));
+        this.arrayElems.forEach((init: string) => out.write(util.format("  %s,\n", init)));
+        out.write("};\n");
+        if (this.arrayStrings.length > 0) {
+            out.write(util.format("static const unsigned s_arrayStrings[%d] = {%s};\n",
+                this.arrayStrings.length, this.arrayStrings.join(",")
+            ));
+        }
+
+        out.write(util.format("static const js::ArrayBoilerplate s_arrayBoilerplates[%d] = {\n",
+            this.arrayBoilerplates.length
+        ));
+        this.arrayBoilerplates.forEach((bp) => {
+            out.write(util.format("  {%d, %d, %s, s_arrayElems + %d},\n",
+                bp.length, bp.holeCount, bp.numbersOnly ? "true" : "false", bp.start
+            ));
+        });
+        out.write("};\n\n");
+    }
+
     generateC (out: NodeJS.WritableStream, strictMode: boolean): void
     {
         var forEachFunc = (m_fb: hir.FunctionBuilder, cb: (m_fb: hir.FunctionBuilder)=>void) => {
@@ -1030,6 +1165,13 @@ int main(int argc, const char ** argv)
                 this.strings.length
             ));
         }
+        if (this.arrayStrings.length > 0) {
+            this.gen(util.format(
+                "\n    for ( unsigned i = 0; i < %d; i += 2 )\n" +
+                "        s_arrayElems[s_arrayStrings[i]] = js::makeStringValue(s_strings[s_arrayStrings[i+1]]);",
+                this.arrayStrings.length
+            ));
+        }
 
         this.gen(
             `
@@ -1051,6 +1193,12 @@ int main(int argc, const char ** argv)
         out.write("\n");
 
         this.outputStringStorage(out);
+        if (this.allocSiteCount > 0)
+            out.write(util.format("static js::AllocSite s_allocSites[%d];\n\n", this.allocSiteCount));
+        if (this.instanceOfSiteCount > 0)
+            out.write(util.format("static js::InstanceOfSite s_instanceOfSites[%d];\n\n", this.instanceOfSiteCount));
+        this.outputBoilerplates(out);
+        this.outputArrayBoilerplates(out);
 
         this.codeSeg.dump(out);
     }
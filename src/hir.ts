@@ -222,6 +222,8 @@ export const enum OpCode
     CLOSURE,
     CREATE,
     CREATE_ARGUMENTS,
+    CREATE_LITERAL,
+    CREATE_CONST_ARRAY,
     LOAD_SC,
     END_TRY,
     ASM,
@@ -313,6 +315,8 @@ var g_opcodeName: string[] = [
     "CLOSURE",
     "CREATE",
     "CREATE_ARGUMENTS",
+    "CREATE_LITERAL",
+    "CREATE_CONST_ARRAY",
     "LOAD_SC",
     "END_TRY",
     "ASM",
@@ -511,6 +515,33 @@ export class PutOp extends Instruction {
     }
 }
 
+/**
+ * Create an object with the data properties 'names', initialized from the argument slots
+ */
+export class CreateLiteralOp extends Instruction {
+    constructor (public dest: LValue, public proto: RValue, public names: string[], public args: ArgSlot[])
+    {
+        super(OpCode.CREATE_LITERAL);
+    }
+    toString (): string {
+        return `${rv2s(this.dest)} = ${oc2s(this.op)}(${rv2s(this.proto)}, [${this.names}], [${this.args}])`;
+    }
+}
+
+/**
+ * Create an array whose elements are the immediate values 'elems'. A null entry is a hole.
+ */
+export class CreateConstArrayOp extends Instruction {
+    constructor (public dest: LValue, public proto: RValue, public elems: RValue[])
+    {
+        super(OpCode.CREATE_CONST_ARRAY);
+    }
+    toString (): string {
+        var elems = this.elems.map((v: RValue) => v !== null ? rv2s(v) : "");
+        return `${rv2s(this.dest)} = ${oc2s(this.op)}(${rv2s(this.proto)}, [${elems}])`;
+    }
+}
+
 export class CallOp extends Instruction {
     public fileName: string = null;
     public line: number = 0;
@@ -724,6 +755,27 @@ export function isValidArrayIndex (s: string): boolean
     return n !== 4294967295 && String(n) === s;
 }
 
+/** Object literals with more properties than this are initialized one property at a time */
+var MAX_LITERAL_PROPS = 64;
+
+/**
+ * Check whether an object literal with these data properties can be described by a static boilerplate: the
+ * names must be distinct and must not be array indexes (which are not stored by name)
+ */
+export function isLiteralShape (names: string[]): boolean
+{
+    if (names.length === 0 || names.length > MAX_LITERAL_PROPS)
+        return false;
+    var seen = new StringMap<boolean>();
+    for ( var i = 0; i < names.length; ++i ) {
+        var name = names[i];
+        if (isValidArrayIndex(name) || seen.has(name))
+            return false;
+        seen.set(name, true);
+    }
+    return true;
+}
+
 /**
  *
  * @param op
@@ -1160,6 +1212,41 @@ export class FunctionBuilder
     {
         this.getBB().push(new UnOp(OpCode.CREATE, dest, src));
     }
+    /**
+     * Create an object with data properties 'names' initialized with 'values'. If the literal has a suitable
+     * shape, the object is created with all of its properties at once, otherwise it is initialized with
+     * PUT-s.
+     */
+    genCreateLiteral(dest: LValue, proto: RValue, names: string[], values: RValue[]): void
+    {
+        assert(names.length === values.length);
+
+        if (!isLiteralShape(names)) {
+            this.genCreate(dest, proto);
+            for ( var i = 0, e = names.length; i < e; ++i )
+                this.genPropSet(dest, names[i], values[i]);
+            return;
+        }
+
+        var bb = this.getBB();
+
+        var slots: ArgSlot[] = Array<ArgSlot>(values.length);
+        for ( var i = 0, e = values.length; i < e; ++i ) {
+            slots[i] = this.getArgSlot(i);
+            bb.push(new AssignOp(slots[i], values[i]));
+        }
+
+        bb.push(new CreateLiteralOp(dest, proto, names, slots));
+    }
+    /**
+     * Create an array whose elements are all immediate values (null for a hole). The elements are emitted
+     * as static data shared by all arrays created here.
+     */
+    genCreateConstArray(dest: LValue, proto: RValue, elems: RValue[]): void
+    {
+        assert(elems.every((v: RValue) => v === null || isImmediate(v)));
+        this.getBB().push(new CreateConstArrayOp(dest, proto, elems));
+    }
     genCreateArguments(dest: LValue): void
     {
         this.getBB().push(new UnOp(OpCode.CREATE_ARGUMENTS, dest, undefinedValue));
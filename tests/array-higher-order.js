@@ -0,0 +1,37 @@
+var a = [1, 2, , 4, 5];
+
+console.log(a.map(function (x, i, arr) { return x * i + (arr === a ? 0 : 1000); }));
+console.log(a.filter(function (x) { return x & 1; }));
+console.log(a.reduce(function (acc, x) { return acc + x; }));
+console.log(a.reduce(function (acc, x, i) { return acc + "," + i; }, "start"));
+console.log(a.some(function (x) { return x > 4; }), a.some(function (x) { return x > 5; }));
+console.log(a.every(function (x) { return x > 0; }), a.every(function (x) { return x > 1; }));
+console.log(a.indexOf(4), a.indexOf(undefined), a.indexOf(4, -1), a.indexOf(5, -1), [NaN].indexOf(NaN));
+
+var ctx = {mul: 3};
+console.log([1, 2].map(function (x) { return x * this.mul; }, ctx));
+
+try {
+    [].reduce(function () {});
+} catch (e) {
+    console.log(e instanceof TypeError);
+}
+try {
+    [1].map(null);
+} catch (e) {
+    console.log(e instanceof TypeError);
+}
+
+// Array-likes
+var o = {length: 3, 0: "a", 2: "c"};
+console.log(Array.prototype.map.call(o, function (x) { return x + x; }));
+console.log(Array.prototype.indexOf.call(o, "c"));
+(function () {
+    console.log(Array.prototype.filter.call(arguments, function (x) { return x !== 2; }));
+})(1, 2, 3);
+
+// The callback may modify the array
+var b = [1, 2, 3, 4];
+var seen = [];
+b.forEach(function (x) { seen.push(x); b.length = 2; });
+console.log(seen);
@@ -0,0 +1,39 @@
+// Arrays change their element kind as values are stored and removed
+var a = [];
+for ( var i = 0; i < 10; ++i )
+    a.push(i * 1.5);
+console.log(a.join(","));
+
+a.length = 15;
+console.log(a[12], a.length, 12 in a);
+a.length = 10;
+a[3] = "three";
+a[4] = {x: 4};
+delete a[5];
+console.log(a[3], a[4].x, a[5], 5 in a, a.length);
+
+var b = a.concat([1, 2], a.slice(0, 3));
+console.log(b.length, b[3], b[4].x, 5 in b, b[11]);
+
+// Sorting numbers, and sorting after the compare function stores strings
+var nums = [5, 3, 9, 1, 7];
+nums.sort(function (x, y) { return x - y; });
+console.log(nums.join(","));
+nums.sort(function (x, y) { nums[0] = "s"; return y - x; });
+console.log(nums.length, typeof nums[0]);
+
+var holes = [3, , 1, undefined, 2];
+holes.sort();
+console.log(holes.join(","), 4 in holes, holes.length);
+
+// Objects stored after a numbers-only phase must stay alive
+var objs = [1, 2, 3];
+for ( var i = 0; i < 1000; ++i )
+    objs[i] = {v: i};
+var garbage = [];
+for ( var i = 0; i < 10000; ++i )
+    garbage.push("g" + i);
+var sum = 0;
+for ( var i = 0; i < objs.length; ++i )
+    sum += objs[i].v;
+console.log(sum);
@@ -0,0 +1,25 @@
+// Array literals of constants share static data until they are modified
+function make ()
+{
+    return [1, -2.5, "a", , null, void 0, 3];
+}
+
+var a = make();
+var b = make();
+console.log(a.length, a[1], a[2], 3 in a, a[4], a[5], a.join());
+a[0] = 100;
+a.push("x");
+console.log(a.join(), b.join(), make().join());
+
+var q = make();
+q.shift();
+q.length = 3;
+console.log(q.join(), make()[0]);
+
+var s = make();
+s.sort();
+console.log(s.join(), make().join());
+
+var n = [3, 1, 2];
+n.reverse();
+console.log(n, [3, 1, 2]);
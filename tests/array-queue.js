@@ -0,0 +1,20 @@
+// A queue built with push() and shift() must stay linear
+var q = [];
+var sum = 0;
+for ( var i = 0; i < 100000; ++i ) {
+    q.push(i, {v: i});
+    if (i % 2 === 0) {
+        sum += q.shift();
+        sum -= q.shift().v;
+    }
+}
+console.log(q.length, sum);
+while (q.length)
+    q.shift();
+console.log(q.length, q.shift());
+
+// Removing from the front with splice()
+var a = [1, 2, , 4, 5, 6];
+console.log(a.splice(0, 3).length, a.join(","), a.length);
+a.unshift(0);
+console.log(a.join(","));
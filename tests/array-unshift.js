@@ -0,0 +1,50 @@
+function dotests (cvt)
+{
+    var x, n;
+
+    x = cvt([10,20,30]);
+    console.log("before", x);
+    n = Array.prototype.unshift.call(x, 1, 2);
+    console.log("after", x, n);
+    console.log();
+
+    x = cvt([10,,30]);
+    console.log("before", x);
+    n = Array.prototype.unshift.call(x, 1);
+    console.log("after", x, n, 2 in x);
+    console.log();
+
+    x = cvt([]);
+    console.log("before", x);
+    n = Array.prototype.unshift.call(x);
+    console.log("after", x, n);
+    console.log();
+
+    // push/shift as a queue
+    x = cvt([]);
+    for ( var i = 0; i < 5; ++i )
+        Array.prototype.push.call(x, i);
+    var out = [];
+    while (x.length)
+        out.push(Array.prototype.shift.call(x));
+    console.log(out.join(","), x.length);
+    console.log();
+}
+
+dotests(function (x){ return x;});
+
+dotests(function (x) {
+    var res = {};
+    x.forEach(function (v, k) { res[k] = v; });
+    res.length = x.length;
+    return res;
+});
+
+// Frozen arrays take the generic path
+var f = Object.freeze([1, 2, 3]);
+try {
+    f.push(4);
+} catch (e) {
+    console.log(e instanceof TypeError);
+}
+console.log(f.length, f[3]);
@@ -1,3 +1,22 @@
 var x = [1,2,3];
 console.log(x.join());
 console.log(x.join(" "));
+console.log([1.5, -7, true, null, undefined, , "s", {toString: function () { return "o"; }}].join("|"));
+console.log(Array.prototype.join.call({length: 3, 0: "a", 2: "c"}, "-"));
+console.log([].join(), [[1, 2], [3]].join(";"));
+
+var rows = [];
+for ( var i = 0; i < 10000; ++i )
+    rows.push([i, i * 0.5, "r" + i].join(","));
+var csv = rows.join("\n");
+console.log(csv.length, csv.slice(-16));
+
+// Sparse arrays only visit their present elements
+var sparse = [];
+sparse[5] = "x";
+sparse[2000000] = {toString: function () { return "o"; }};
+sparse[7] = 1;
+var joined = sparse.join();
+console.log(joined.length, joined.slice(0, 10), joined.slice(-3));
+sparse.length = 9;
+console.log(sparse.join("-"));
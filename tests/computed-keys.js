@@ -0,0 +1,15 @@
+// Computed property names go through the intern pool
+var o = {};
+for ( var i = 0; i < 50000; ++i )
+    o["key" + i] = i;
+var sum = 0;
+for ( var i = 0; i < 50000; i += 7 )
+    sum += o["key" + i];
+console.log(sum, Object.keys(o).length, o["key" + 49999], "key50000" in o);
+
+for ( var i = 0; i < 50000; i += 2 )
+    delete o["key" + i];
+console.log(Object.keys(o).length, o.key1, o.key2);
+
+var s = "a\u0000b";
+console.log(s === "a\u0000c", s === "a" + "\u0000" + "b");
@@ -35,3 +35,36 @@ Object.defineProperty(x, "a", {value: 1, writable: true, enumerable: true});
 Object.freeze(x);
 assertThrow(function(){Object.defineProperty(x, "a", {value: 1, writable: true, enumerable: true});});
 assertThrow(function(){Object.defineProperty(x, "a", {value: 2, writable: true, enumerable: true});});
+
+// Descriptors which are not plain literals
+var x = {};
+var desc = Object.create({enumerable: true});
+desc.value = 10;
+Object.defineProperty(x, "a", desc);
+assert(x.a === 10 && Object.keys(x).length === 1);
+var calls = 0;
+Object.defineProperty(x, "b", {get value () { ++calls; return 20; }});
+assert(x.b === 20 && calls === 1 && Object.keys(x).length === 1);
+assertThrow(function(){Object.defineProperty(x, "c", {value: 1, get: function(){}});});
+assertThrow(function(){Object.defineProperty(x, "c", {get: 1});});
+assertThrow(function(){Object.defineProperty(x, "c", 1);});
+Object.defineProperty(x, "c", {get: function(){ return 30; }, set: undefined});
+assert(x.c === 30);
+
+// Only the own enumerable properties define properties
+var props = Object.create({inherited: {value: 1}});
+props.d = {value: 40, enumerable: true};
+Object.defineProperty(props, "hiddenProp", {value: {value: 1}});
+Object.defineProperties(x, props);
+assert(x.d === 40 && !("inherited" in x) && !("hiddenProp" in x));
+
+// All descriptors are converted before any property is defined
+var y = {};
+assertThrow(function(){
+    Object.defineProperties(y, {p: {value: 1}, q: {get value () { throw new Error("q"); }}});
+});
+assert(!("p" in y) && !("q" in y));
+assertThrow(function(){ Object.defineProperties(y, {p: {value: 1}, q: {get: 2}}); });
+assert(!("p" in y));
+Object.defineProperties(y, {p: {value: 1, enumerable: true}, 2: {value: 3, enumerable: true}});
+assert(y.p === 1 && y[2] === 3 && Object.keys(y).length === 2);
@@ -0,0 +1,30 @@
+function P () {}
+P.prototype.inherited = 1;
+
+function show (o) {
+    var res = [];
+    for ( var k in o )
+        res.push(k);
+    console.log(res.join(","), Object.keys(o).join(","));
+}
+
+var a = new P(), b = new P();
+a.x = 1; a.y = 2;
+b.x = 3; b.y = 4;
+show(a);
+show(b);
+
+// Changes to the object or the prototype must be reflected
+b.z = 5;
+show(b);
+P.prototype.more = 2;
+show(a);
+Object.defineProperty(a, "x", {enumerable: false});
+show(a);
+
+// Properties deleted during the enumeration are skipped
+for ( var k in b ) {
+    console.log(k);
+    if (k === "x")
+        delete b.z;
+}
@@ -0,0 +1,39 @@
+// The standard properties of closures are created on first use
+function make (i) {
+    return function inner (a, b) { return a + b + i; };
+}
+
+var fns = [];
+for ( var i = 0; i < 5; ++i )
+    fns.push(make(i));
+
+console.log(fns[0](1, 2), fns[4](1, 2));
+console.log(fns[1].length, fns[1].name, "prototype" in fns[2], fns[2].hasOwnProperty("length"));
+console.log(typeof fns[3].prototype, fns[3].prototype.constructor === fns[3]);
+console.log(Object.keys(fns[0]).length);
+
+// Constructors get their prototype when first used with 'new'
+function Point (x) { this.x = x; }
+var p = new Point(10);
+console.log(p.x, p instanceof Point, Object.getPrototypeOf(p) === Point.prototype);
+
+// Replacing the prototype before it was created
+var F = make(0);
+F.prototype = {tag: "custom"};
+console.log(new F().tag);
+
+// Inheriting from a function
+var d = Object.create(make(1));
+console.log(d.length, d.name);
+
+// Freezing before the properties are created
+var frozen = make(2);
+Object.freeze(frozen);
+console.log(typeof frozen.prototype, frozen.length);
+
+// Deleting and enumerating
+var g = make(3);
+g.extra = 1;
+console.log(delete g.prototype, "prototype" in g, Object.keys(g).join(","));
+for ( var k in make(4) )
+    console.log("enumerated", k);
@@ -0,0 +1,11 @@
+var a = [10, 20, 30];
+console.log(a["1"], a["01"], a["1.0"], a[" 1"]);
+a["01"] = "x";
+console.log(a.length, a[1], a["01"]);
+
+var o = {};
+o["4294967294"] = "last index";
+o["4294967295"] = "not an index";
+o["007"] = "bond";
+o[7] = "seven";
+console.log(Object.keys(o).join(","));
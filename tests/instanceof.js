@@ -19,3 +19,17 @@ console.log(ch instanceof Base);
 
 if (ch instanceof Base)
     console.log("YES");
+
+// The same site with different receivers and after the prototype has been replaced
+function countInstances (list, ctor) {
+    var n = 0;
+    for ( var i = 0; i < list.length; ++i )
+        if (list[i] instanceof ctor)
+            ++n;
+    return n;
+}
+
+var list = [ch, new Base(1), new Other(), {}, ch];
+console.log(countInstances(list, Base), countInstances(list, Child), countInstances(list, Other));
+Other.prototype = Base.prototype;
+console.log(countInstances(list, Other), new Base(2) instanceof Other);
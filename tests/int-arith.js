@@ -0,0 +1,21 @@
+// Integer arithmetic must overflow into doubles and preserve -0
+var max = 2147483647, min = -2147483648;
+console.log(max + 1, min - 1, 65536 * 65536, max * 2);
+console.log(1 / (-1 * 0), 1 / (0 * -5), 1 / (0 * 5), 1 / (-0 + 0), 1 / (-0 - 0));
+console.log(7 / 2, -7 % 2, 1 / (-4 % 2));
+console.log(~0, ~max, -1 >>> 0, -1 >> 1, 1 << 31, (1 << 31) >>> 0, 5 & 3, 5 | 3, 5 ^ 3);
+
+var sum = 0;
+for ( var i = 0; i < 100000; ++i )
+    sum += i;
+console.log(sum);
+
+var prod = 1;
+for ( var i = 1; i < 20; ++i )
+    prod *= i;
+console.log(prod);
+
+var a = [];
+for ( var i = 0; i < 10; ++i )
+    a[i] = i * i;
+console.log(a[9], a[-1], a[4294967294], a.length, a[2.5], a[3.0]);
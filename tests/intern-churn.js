@@ -0,0 +1,26 @@
+// Interned property names die and are removed from the intern table while it is still growing into a
+// larger one. A name which was removed must not be found again.
+var survivors = {};
+for ( var wave = 0; wave < 20; ++wave ) {
+    var tmp = {};
+    for ( var i = 0; i < 3000; ++i )
+        tmp["w" + wave + "_" + i] = i;
+    survivors["keep" + wave] = tmp["w" + wave + "_" + (wave * 100)];
+    tmp = null;
+
+    // Enough garbage to collect the names of the previous waves
+    var junk = [];
+    for ( var i = 0; i < 20000; ++i )
+        junk.push({v: i});
+}
+
+var fresh = {};
+var hits = 0;
+for ( var wave = 0; wave < 20; ++wave )
+    for ( var i = 0; i < 3000; i += 37 )
+        if (("w" + wave + "_" + i) in fresh)
+            ++hits;
+var sum = 0;
+for ( var wave = 0; wave < 20; ++wave )
+    sum += survivors["keep" + wave];
+console.log(hits, sum, Object.keys(survivors).length);
@@ -0,0 +1,59 @@
+// Native Map and Set
+var m = new Map([[1, "one"], ["1", "string one"], [NaN, "nan"]]);
+console.log(m.size, m.get(1), m.get("1"), m.get(NaN), m.has(2));
+m.set(-0, "zero");
+console.log(m.get(0), m.get(-0), m.size);
+
+var key = {};
+m.set(key, "object").set(2, "two");
+console.log(m.get(key), m.get({}), m.get(2));
+console.log(m.delete(1), m.delete(1), m.size);
+
+var keys = [];
+m.forEach(function (v, k, map) { keys.push(String(k)); console.assert(map === m); });
+console.log(keys.join(","));
+
+// Insertion order survives deletes and growth
+var big = new Map();
+for ( var i = 0; i < 1000; ++i )
+    big.set(i, i * 2);
+for ( var i = 0; i < 1000; i += 2 )
+    big.delete(i);
+var it = big.keys();
+console.log(it.next().value, it.next().value, big.size);
+for ( var i = 0; i < 1000; ++i )
+    big.set("k" + i, i);
+console.log(it.next().value, big.get("k999"), big.size);
+
+var e = new Map([["a", 1]]).entries().next();
+console.log(e.value[0], e.value[1], e.done);
+
+// Entries added during forEach are visited
+var grow = new Set([1]);
+grow.forEach(function (v) { if (v < 5) grow.add(v + 1); });
+console.log(grow.size);
+
+var s = new Set("hello");
+console.log(s.size, s.has("l"), s.has("x"));
+s.add("x").add("x");
+console.log(s.size, s.delete("h"), s.size);
+
+var vals = [];
+for ( var iter = s.values(), r = iter.next(); !r.done; r = iter.next() )
+    vals.push(r.value);
+console.log(vals.join(""));
+s.clear();
+console.log(s.size, iter.next().done);
+
+console.log(Object.prototype.toString.call(m), Object.prototype.toString.call(s));
+
+try {
+    Map.prototype.get.call({}, 1);
+} catch (ex) {
+    console.log(ex instanceof TypeError);
+}
+try {
+    Map();
+} catch (ex) {
+    console.log(ex instanceof TypeError);
+}
@@ -0,0 +1,13 @@
+// Every NaN bit pattern must read back as NaN, including the negative ones
+var view = new DataView(new ArrayBuffer(8));
+var patterns = [[0x7FF80000, 0], [0xFFF80000, 0], [0xFFFFFFFF, 0xFFFFFFFF], [0x7FF00000, 1], [0xFFF00000, 1]];
+for ( var i = 0; i < patterns.length; ++i ) {
+    view.setUint32(0, patterns[i][0]);
+    view.setUint32(4, patterns[i][1]);
+    var x = view.getFloat64(0);
+    console.log(typeof x, x !== x, isNaN(x), [x].indexOf(x));
+}
+
+var f = new Float64Array([-Infinity, -0, Number.MAX_VALUE, -Number.MIN_VALUE]);
+console.log(f[0], 1 / f[1], f[2], f[3]);
+console.log(typeof null, typeof undefined, typeof true, typeof {}, [,1][0]);
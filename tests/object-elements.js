@@ -0,0 +1,43 @@
+function show (o) {
+    var res = [];
+    for ( var k in o )
+        res.push(k + "=" + o[k]);
+    console.log(res.join(","), Object.keys(o).join(","));
+}
+
+// Numeric keys are enumerated first, in ascending order
+var m = {};
+m.name = "map";
+m[10] = "ten";
+m[2] = "two";
+m["0"] = "zero";
+show(m);
+console.log(m[2], m["10"], m[3], 2 in m, 3 in m, m.hasOwnProperty(10));
+
+// Sparse keys
+m[1000000] = "million";
+m[4294967294] = "max";
+m[4294967295] = "not an index";
+show(m);
+delete m[2];
+delete m["1000000"];
+show(m);
+
+// Inherited elements
+var d = Object.create(m);
+d[5] = "five";
+console.log(d[0], d[5], m[5], d.hasOwnProperty(0));
+show(d);
+
+// Explicit attributes
+Object.defineProperty(m, 0, {enumerable: false});
+m[0] = "changed";
+show(m);
+console.log(m[0]);
+
+var f = {1: "a"};
+Object.freeze(f);
+f[1] = "b";
+f[2] = "c";
+delete f[1];
+console.log(f[1], f[2]);
@@ -0,0 +1,49 @@
+// Literal properties are defined, not assigned, so setters on the prototype are not invoked
+Object.defineProperty(Object.prototype, "hidden", {
+    set: function (v) { console.log("setter called", v); },
+    configurable: true
+});
+
+function makePoint (x, y) {
+    return {x: x, y: y, hidden: x + y};
+}
+
+for ( var i = 0; i < 3; ++i ) {
+    var p = makePoint(i, i * 2);
+    console.log(p.x, p.y, p.hidden, Object.keys(p).join(","));
+}
+
+// Values are evaluated in order, before the object is created
+var n = 0;
+var o = {a: n, b: ++n, c: n++, d: n};
+console.log(o.a, o.b, o.c, o.d);
+
+// Duplicate, numeric and accessor keys
+var dup = {a: 1, b: 2, a: 3};
+console.log(dup.a, dup.b, Object.keys(dup).join(","));
+var num = {x: 1, 1: "one", 0: "zero"};
+console.log(num[0], num[1], num.x, Object.keys(num).join(","));
+var acc = {v: 10, get w () { return this.v * 2; }};
+console.log(acc.v, acc.w);
+
+// Nested literals
+var nested = {inner: {a: 1, b: {c: 2}}, list: [1, 2]};
+console.log(nested.inner.a, nested.inner.b.c, nested.list.length);
+
+// Duplicate, numeric and many keys with values which are not constants
+function f () { return "f"; }
+function g () { return "g"; }
+var x = 1;
+console.log(({0: f()})[0], ({1: x})[1], ({0: x, 1: f()})[1]);
+var dupCalls = {a: g(), b: 1, b: 2};
+console.log(dupCalls.a, dupCalls.b);
+var dupVars = {a: x, b: f(), a: g()};
+console.log(dupVars.a, dupVars.b, Object.keys(dupVars).join(","));
+var many = {p0: f(), p1: x, p2: 2, p3: 3, p4: 4, p5: 5, p6: 6, p7: 7, p8: 8, p9: 9,
+    p10: 10, p11: 11, p12: 12, p13: 13, p14: 14, p15: 15, p16: 16, p17: 17, p18: 18, p19: 19,
+    p20: 20, p21: 21, p22: 22, p23: 23, p24: 24, p25: 25, p26: 26, p27: 27, p28: 28, p29: 29,
+    p30: 30, p31: 31, p32: 32, p33: 33, p34: 34, p35: 35, p36: 36, p37: 37, p38: 38, p39: 39,
+    p40: 40, p41: 41, p42: 42, p43: 43, p44: 44, p45: 45, p46: 46, p47: 47, p48: 48, p49: 49,
+    p50: 50, p51: 51, p52: 52, p53: 53, p54: 54, p55: 55, p56: 56, p57: 57, p58: 58, p59: 59,
+    p60: 60, p61: 61, p62: 62, p63: 63, p64: 64};
+console.log(many.p0, many.p1, many.p64, Object.keys(many).length);
@@ -0,0 +1,24 @@
+function Point (x, y) {
+    this.x = x;
+    this.y = y;
+}
+
+function makeRecord (i) {
+    var r = {};
+    r.id = i;
+    r.name = "rec" + i;
+    r.value = i * 2;
+    return r;
+}
+
+// Later objects reserve slots based on the earlier ones
+for ( var i = 0; i < 3; ++i ) {
+    var p = new Point(i, i + 1);
+    p.z = i + 2;
+    var r = makeRecord(i);
+    delete r.name;
+    r.extra = true;
+    r.name = "again" + i;
+    console.log(p.x, p.y, p.z, Object.keys(p).join(","));
+    console.log(r.id, r.name, r.value, r.extra, Object.keys(r).join(","));
+}
@@ -0,0 +1,24 @@
+function Base () {}
+Base.prototype.m = function () { return "base"; };
+
+function Child () {}
+Child.prototype = Object.create(Base.prototype);
+
+var c = new Child();
+console.log(c.m(), c.x);
+
+// Changes to any prototype in the chain must be visible to subsequent lookups
+Child.prototype.m = function () { return "child"; };
+Base.prototype.x = 10;
+console.log(c.m(), c.x);
+
+delete Child.prototype.m;
+console.log(c.m());
+
+// Methods of primitives go through the prototypes of their wrappers
+String.prototype.twice = function () { return this + this; };
+console.log("ab".twice());
+Object.prototype.twice = function () { return "object"; };
+console.log("ab".twice(), (5).twice());
+delete String.prototype.twice;
+console.log("ab".twice());
@@ -0,0 +1,40 @@
+// Huge sparse arrays only store their existing elements
+var a = new Array(1e9);
+console.log(a.length, a[5], 5 in a);
+a[4000000000 - 2] = "last";
+a[7] = "seven";
+console.log(a.length, a[4000000000 - 2], a[7]);
+
+var keys = [];
+for ( var k in a )
+    keys.push(k);
+console.log(keys.join(","));
+console.log(Object.keys(a).length);
+
+a.sort();
+console.log(a[0], a[1], 2 in a, a.length);
+
+delete a[0];
+console.log(0 in a, a[1]);
+
+// Shrinking and refilling makes the array dense again
+a.length = 3;
+console.log(a.length, a[1]);
+
+var b = new Array(100000);
+for ( var i = 0; i < b.length; ++i )
+    b[i] = i;
+var sum = 0;
+for ( var i = 0; i < b.length; ++i )
+    sum += b[i];
+console.log(sum);
+
+var c = [];
+c[1000000] = 1;
+c[10] = 2;
+var d = c.concat([3]);
+console.log(d.length, d[10], d[1000000], d[1000001], 11 in d);
+var e = c.slice(5, 20);
+console.log(e.length, e[5]);
+
+Object.defineProperties({}, [{value: 1}]);
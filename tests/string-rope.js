@@ -0,0 +1,19 @@
+// Long concatenations are built lazily as ropes
+var s = "";
+for ( var i = 0; i < 100000; ++i )
+    s += "abé";
+console.log(s.length, s.charCodeAt(299999), s.charAt(3), s.indexOf("éa"), s.lastIndexOf("b"));
+
+var prefix = "";
+for ( var i = 0; i < 100; ++i )
+    prefix = prefix + i + ",";
+var a = prefix + "a";
+var b = prefix + "b";
+console.log(a.length, a.slice(-3), b.slice(-3), a === b, a.slice(0, -1) === b.slice(0, -1));
+
+var o = {};
+o[prefix + "key"] = 1;
+console.log(o[prefix + "key"], Object.keys(o)[0].length);
+
+console.log(/9,a$/.test(a), a.split(",").length, a.toUpperCase().slice(-2));
+console.log("" + s === s, (s + "").length, s.substring(299997));
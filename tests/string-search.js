@@ -0,0 +1,21 @@
+// indexOf/lastIndexOf over long strings, with short and long needles
+var line = "2015-06-01 12:00:00 INFO request handled path=/api/items\n";
+var log = "";
+for ( var i = 0; i < 500; ++i )
+    log += line;
+var needle = "ERROR request failed path=/api/items/with/a/long/suffix";
+var big = log + needle + log;
+
+console.log(big.indexOf("ERROR"), big.lastIndexOf("ERROR"), big.indexOf("WARN"));
+console.log(big.indexOf(needle), big.lastIndexOf(needle), big.indexOf(needle, big.indexOf(needle) + 1));
+console.log(big.indexOf("INFO", 100), big.lastIndexOf("INFO"), big.lastIndexOf("INFO", 100));
+console.log(big.indexOf("\n"), big.lastIndexOf("\n"), big.indexOf(""), big.lastIndexOf("") === big.length);
+
+// Periodic text, where the first and last bytes of the needle match almost everywhere
+var a = "";
+for ( var i = 0; i < 2000; ++i )
+    a += "ab";
+console.log(a.indexOf("abababababababababababababababababababc"), a.indexOf("ba"), a.lastIndexOf("ab"));
+console.log((a + "abc").indexOf("ababababababababababababababababababababc"));
+
+console.log(big.split("ERROR").length, log.split("\n").length);
@@ -0,0 +1,40 @@
+// Long substrings share the characters of their parent
+var input = new Array(2001).join("name=valué;");
+
+var parts = input.split(";");
+console.log(parts.length, parts[0], parts[1999]);
+
+var long = input.substring(11, 11 * 50);
+console.log(long.length, long.slice(0, 11), long.slice(-11), long.indexOf("é"));
+
+var tail = input.slice(-100);
+console.log(tail.length, tail === input.substr(input.length - 100), tail.charCodeAt(99));
+
+var re = /(name=(valu.)(;name=valu.){5})/;
+var m = re.exec(input);
+console.log(m[1].length, m[2], m[3]);
+
+var o = {};
+o[long] = 1;
+console.log(o[input.substring(11, 11 * 50)], Object.keys(o)[0] === long);
+console.log(long + tail === input.substring(11, 550) + input.slice(-100));
+
+// A tail slice used as a property name outlives its parent
+function tailKey (reps) {
+    var big = new Array(reps + 1).join("abcdefghij") + "-tail";
+    var key = big.slice(-100);
+    var obj = {};
+    obj[key] = 42;
+    return obj;
+}
+var keyed = tailKey(100), keyedShared = tailKey(20);
+for ( var gc = 0; gc < 5; ++gc ) {
+    var junk = [];
+    for ( var i = 0; i < 20000; ++i )
+        junk.push({v: i});
+}
+var keyName = new Array(11).join("abcdefghij").slice(5) + "-tail";
+console.log(keyed[keyName], Object.keys(keyed)[0] === keyName, keyName in keyed);
+console.log(keyedShared[keyName], Object.keys(keyedShared)[0] === keyName, keyName in keyedShared);
+for ( var k in keyedShared )
+    console.log(k.length, k.slice(-5));
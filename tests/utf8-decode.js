@@ -0,0 +1,38 @@
+// Decoding UTF-8 from a Buffer: the bulk path for valid input and the replacement path for invalid input
+var Buffer = require("buffer").Buffer;
+
+function decode (bytes) {
+    return new Buffer(bytes).toString("utf8");
+}
+
+function repeat (bytes, n) {
+    var res = [];
+    for ( var i = 0; i < n; ++i )
+        res.push.apply(res, bytes);
+    return res;
+}
+
+// Short and long ASCII
+console.log(decode([0x61, 0x62, 0x63]), decode(repeat([0x61], 100)).length);
+
+// Multi-byte characters on both sides of the 16 and 32 byte blocks
+var s = decode(repeat([0x61], 15).concat([0xD0, 0xB9], repeat([0x62], 14), [0xE2, 0x82, 0xAC]));
+console.log(s.length, s.charCodeAt(15).toString(16), s.charCodeAt(30).toString(16));
+
+// Supplementary characters count as two UTF-16 units
+s = decode(repeat([0xF0, 0x9F, 0x98, 0x80], 20));
+console.log(s.length, s.charCodeAt(0).toString(16), s.charCodeAt(1).toString(16));
+s = decode([0x78, 0xF0, 0x9F, 0x98, 0x80, 0xFF]);
+console.log(s.length, s.charCodeAt(1).toString(16), s.charCodeAt(3).toString(16));
+
+// Invalid input: overlong forms, surrogates, stray continuation bytes, a truncated tail
+function codes (str) {
+    var res = [];
+    for ( var i = 0; i < str.length; ++i )
+        res.push(str.charCodeAt(i).toString(16));
+    return res.join(" ");
+}
+console.log(codes(decode(repeat([0x61], 40).concat([0xC0, 0xAF]))).slice(-14));
+console.log(codes(decode(repeat([0x61], 40).concat([0xED, 0xA0, 0x80, 0x62]))).slice(-7));
+console.log(codes(decode([0x80, 0x61])));
+console.log(codes(decode(repeat([0x61], 40).concat([0xE2, 0x82]))).slice(-7));